@@ -0,0 +1,460 @@
+/*
+ * Benchmarks of extraction, packing and hashing on synthetic CSVB files.
+ * The files are generated from the shipped structures at a configurable scale, so results are comparable between
+ * versions without game data. Run it from a folder containing the structures folder, like DWNOTools itself.
+ */
+#include "CSVB.hpp"
+#include "CSVWriter.hpp"
+#include "RainbowTable.hpp"
+#include "StructureRegistry.hpp"
+#include "utils.hpp"
+
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    // the shapes of the shipped files, rows per table at scale 1
+    struct Shape
+    {
+        const char* name;      // file name, selects the structure
+        const char* structure; // structure file
+        uint32_t rows;
+    };
+
+    constexpr Shape SHAPES[] = {
+        { "map_0001", "map.json", 250 },
+        { "DigimonData", "DigimonData.json", 500 },
+        { "lang_en", "lang.json", 4000 },
+    };
+
+    struct Sample
+    {
+        std::string name;
+        std::vector<double> seconds;
+        uint64_t bytes = 0; // processed per iteration, for the throughput
+        uint64_t items = 0; // hashes, rows, ... per iteration
+    };
+
+    class Generator
+    {
+        std::mt19937 random;
+        std::vector<std::string> words;
+        std::vector<std::string> names;
+
+    public:
+        explicit Generator(uint32_t seed)
+            : random(seed)
+        {
+            const std::string letters = "abcdefghijklmnopqrstuvwxyz ";
+            for (int i = 0; i < 2000; i++)
+            {
+                std::string word;
+                auto length = std::uniform_int_distribution<int>(3, 60)(random);
+                for (int j = 0; j < length; j++)
+                    word.push_back(letters[std::uniform_int_distribution<std::size_t>(0, letters.size() - 1)(random)]);
+                words.push_back(word);
+            }
+
+            // half of the names are known to the rainbow table, like in real files
+            for (int i = 0; i < 4000; i++)
+            {
+                names.push_back(std::format("bench_name_{:04}", i));
+                if (i % 2 == 0) RainbowTable::addHash(names.back());
+            }
+        }
+
+        const std::vector<std::string>& getWords() const { return words; }
+
+        std::string csv(const TableStructure& table, uint32_t rows)
+        {
+            CSVWriter output;
+            for (auto& column : table.columns)
+                output.writeString(column);
+            output.endRow();
+
+            for (uint32_t i = 0; i < rows; i++)
+            {
+                for (auto type : table.types)
+                    writeValue(output, type);
+                output.endRow();
+            }
+
+            return output.release();
+        }
+
+    private:
+        void writeValue(CSVWriter& output, DataType type)
+        {
+            auto& traits = getTypeTraits(type);
+            switch (traits.kind)
+            {
+                case FieldKind::INTEGER:
+                {
+                    int32_t limit = traits.size == 1 ? 127 : traits.size == 2 ? 32767 : 1000000;
+                    output.writeInt(std::uniform_int_distribution<int32_t>(-limit / 10, limit)(random));
+                    break;
+                }
+                case FieldKind::FLOAT:
+                    output.writeFloat(std::uniform_real_distribution<float>(-100, 1000)(random));
+                    break;
+                case FieldKind::FIXED:
+                    output.writeDouble(std::uniform_int_distribution<int32_t>(-1 << 20, 1 << 24)(random) / 4096.0);
+                    break;
+                case FieldKind::HASH: output.writeString(pick(names)); break;
+                case FieldKind::STRING_REF: output.writeString(pick(words)); break;
+                case FieldKind::INLINE_STRING: output.writeString(pick(words).substr(0, traits.size)); break;
+                case FieldKind::UNSUPPORTED:
+                    throw std::invalid_argument(std::format("Can't generate values of type {}.", traits.name));
+            }
+        }
+
+        const std::string& pick(const std::vector<std::string>& list)
+        {
+            return list[std::uniform_int_distribution<std::size_t>(0, list.size() - 1)(random)];
+        }
+    };
+
+    class Benchmark
+    {
+        uint32_t iterations;
+        std::vector<Sample> samples;
+
+    public:
+        explicit Benchmark(uint32_t iterations)
+            : iterations(iterations)
+        {
+        }
+
+        // runs function once to warm up, then times it the configured number of times
+        Sample& run(std::string name, const std::function<void()>& function)
+        {
+            function();
+
+            Sample sample{ std::move(name), {} };
+            for (uint32_t i = 0; i < iterations; i++)
+            {
+                auto start = Clock::now();
+                function();
+                sample.seconds.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+            }
+
+            std::cerr << std::format("{:32} {:10.3f} ms", sample.name, median(sample.seconds) * 1000) << std::endl;
+            return samples.emplace_back(std::move(sample));
+        }
+
+        // a single measurement, for things that only happen once
+        Sample& once(std::string name, const std::function<void()>& function)
+        {
+            auto start = Clock::now();
+            function();
+
+            Sample sample{ std::move(name), { std::chrono::duration<double>(Clock::now() - start).count() } };
+            std::cerr << std::format("{:32} {:10.3f} ms", sample.name, sample.seconds[0] * 1000) << std::endl;
+            return samples.emplace_back(std::move(sample));
+        }
+
+        boost::json::object toJSON() const
+        {
+            boost::json::array results;
+            for (auto& sample : samples)
+            {
+                auto sorted = sample.seconds;
+                std::sort(sorted.begin(), sorted.end());
+
+                boost::json::object result;
+                result["name"]       = sample.name;
+                result["iterations"] = sorted.size();
+                result["min"]        = sorted.front();
+                result["median"]     = median(sorted);
+                result["mean"]       = std::accumulate(sorted.begin(), sorted.end(), 0.0) / sorted.size();
+                result["max"]        = sorted.back();
+                if (sample.bytes != 0) result["bytesPerSecond"] = sample.bytes / median(sorted);
+                if (sample.items != 0) result["itemsPerSecond"] = sample.items / median(sorted);
+                results.push_back(result);
+            }
+
+            boost::json::object json;
+            json["results"] = results;
+            return json;
+        }
+
+        static double median(std::vector<double> values)
+        {
+            std::sort(values.begin(), values.end());
+            return values[values.size() / 2];
+        }
+    };
+
+    std::vector<char> generateFile(Generator& generator, const Structure& structure, uint32_t rows)
+    {
+        std::vector<std::string> texts;
+        CSVBImporter::TableSources sources;
+
+        texts.reserve(structure.tables.size());
+        for (auto& table : structure.tables)
+        {
+            texts.push_back(generator.csv(table, rows));
+            sources[table.name] = std::as_bytes(std::span(texts.back()));
+        }
+
+        CSVBImporter importer(structure, sources);
+        std::vector<char> file(importer.packedSize());
+        importer.writeTo(std::as_writable_bytes(std::span(file)));
+        return file;
+    }
+
+    void writeFile(const std::filesystem::path& path, std::span<const char> data)
+    {
+        std::filesystem::create_directories(path.parent_path());
+        std::ofstream output(path, std::ios::out | std::ios::binary);
+        output.write(data.data(), data.size());
+        if (!output) throw std::runtime_error("Error: failed to write " + path.string());
+    }
+
+    void benchmarkFile(Benchmark& bench,
+                       const Shape& shape,
+                       const std::vector<char>& file,
+                       const std::filesystem::path& workPath)
+    {
+        auto bytes = std::as_bytes(std::span(file));
+        auto name  = std::string(shape.name);
+
+        uint64_t rows = 0;
+        {
+            CSVBExporter exporter(bytes, name);
+            for (std::size_t t = 0; t < exporter.getView().tableCount(); t++)
+                rows += exporter.getView().table(t).entryCount();
+        }
+
+        // in memory, without any file system access
+        std::vector<std::string> texts;
+        auto& exportSample = bench.run(name + "/export",
+                                       [&]
+                                       {
+                                           CSVBExporter exporter(bytes, name);
+                                           texts.clear();
+                                           for (std::size_t t = 0; t < exporter.getView().tableCount(); t++)
+                                           {
+                                               CSVWriter output;
+                                               exporter.writeTable(t, output);
+                                               texts.push_back(output.release());
+                                           }
+                                       });
+        exportSample.bytes = file.size();
+        exportSample.items = rows;
+
+        auto structure = StructureRegistry::find(name);
+        CSVBImporter::TableSources sources;
+        for (std::size_t t = 0; t < texts.size(); t++)
+            sources[structure->tables[t].name] = std::as_bytes(std::span(texts[t]));
+
+        std::vector<std::byte> packed(file.size());
+        auto& importSample = bench.run(name + "/import",
+                                       [&]
+                                       {
+                                           CSVBImporter importer(*structure, sources);
+                                           importer.writeTo(packed);
+                                       });
+        importSample.bytes = file.size();
+        importSample.items = rows;
+
+        if (std::memcmp(packed.data(), file.data(), file.size()) != 0)
+            throw std::runtime_error(std::format("{}: packing the export doesn't give the original file.", name));
+
+        // through the file system, like the command line
+        auto inputPath   = workPath / "input" / name;
+        auto extractPath = workPath / "extracted";
+        auto packPath    = workPath / "packed" / name;
+        writeFile(inputPath, file);
+
+        auto& extractSample = bench.run(name + "/extract",
+                                        [&]
+                                        {
+                                            CSVBExporter exporter(inputPath);
+                                            exporter.write(extractPath, false);
+                                        });
+        extractSample.bytes = file.size();
+        extractSample.items = rows;
+
+        auto& packSample = bench.run(name + "/pack",
+                                     [&]
+                                     {
+                                         CSVBImporter importer(extractPath / name);
+                                         importer.write(packPath);
+                                     });
+        packSample.bytes = file.size();
+        packSample.items = rows;
+
+        auto& roundTripSample = bench.run(name + "/roundtrip",
+                                          [&]
+                                          {
+                                              CSVBExporter exporter(inputPath);
+                                              exporter.write(extractPath, false);
+                                              CSVBImporter importer(extractPath / name);
+                                              importer.write(packPath);
+                                          });
+        roundTripSample.bytes = file.size();
+        roundTripSample.items = rows;
+    }
+
+    void benchmarkHashes(Benchmark& bench, const std::vector<std::string>& words, uint32_t scale)
+    {
+        std::vector<std::string_view> inputs;
+        for (uint32_t i = 0; i < 100 * scale; i++)
+            inputs.insert(inputs.end(), words.begin(), words.end());
+
+        uint64_t bytes = 0;
+        for (auto input : inputs)
+            bytes += input.size();
+
+        std::vector<uint32_t> outputs(inputs.size());
+        auto& scalar = bench.run("hash/scalar",
+                                 [&]
+                                 {
+                                     for (std::size_t i = 0; i < inputs.size(); i++)
+                                         outputs[i] = makeHash(inputs[i]);
+                                 });
+        scalar.bytes = bytes;
+        scalar.items = inputs.size();
+
+        auto& batch = bench.run(std::format("hash/batch_{}", getHashBackendName(getHashBackend())),
+                                [&] { makeHashes(inputs, outputs); });
+        batch.bytes = bytes;
+        batch.items = inputs.size();
+    }
+
+    // a new folder below parent, so nothing but the benchmark's own files is ever removed
+    std::filesystem::path createWorkFolder(const std::filesystem::path& parent)
+    {
+        std::filesystem::create_directories(parent);
+
+        std::random_device random;
+        for (uint32_t attempt = 0; attempt < 100; attempt++)
+        {
+            auto path = parent / std::format("dwno_bench-{:08x}", random());
+            if (std::filesystem::create_directory(path)) return path;
+        }
+        throw std::runtime_error(std::format("Couldn't create a work folder in {}.", parent.string()));
+    }
+} // namespace
+
+int main(int count, char* args[])
+{
+    namespace po = boost::program_options;
+
+    po::options_description desc("Usage: dwno_bench [options]\n\nAllowed Options");
+
+    auto options = desc.add_options();
+    options("help,h", "This text.");
+    options("scale,s", po::value<uint32_t>()->default_value(1), "Multiplies the number of rows and hashes.");
+    options("iterations,n", po::value<uint32_t>()->default_value(10), "Timed runs of every benchmark.");
+    options("output,o", po::value<std::string>(), "Write the results as JSON to this file instead of stdout.");
+    options("work,w",
+            po::value<std::string>()->default_value(std::filesystem::temp_directory_path().string()),
+            "Folder to put the generated files in. They go into a new dwno_bench-<id> folder inside it, which is "
+            "removed afterwards.");
+    options("tool",
+            po::value<std::string>(),
+            "Path of the DWNOTools executable, to also measure the start up of a whole process.");
+
+    po::variables_map vm;
+    try
+    {
+        po::store(po::command_line_parser(count, args).options(desc).run(), vm);
+        po::notify(vm);
+    }
+    catch (std::exception& e)
+    {
+        std::cout << e.what() << std::endl;
+        return 1;
+    }
+
+    if (vm.count("help"))
+    {
+        std::cout << desc << std::endl;
+        return 0;
+    }
+
+    auto scale      = std::max(vm["scale"].as<uint32_t>(), 1u);
+    auto iterations = std::max(vm["iterations"].as<uint32_t>(), 1u);
+    std::filesystem::path workPath;
+
+    try
+    {
+        workPath = createWorkFolder(vm["work"].as<std::string>());
+
+        Benchmark bench(iterations);
+
+        // everything a fresh process loads on first use
+        bench.once("startup/rainbow_table", [] { RainbowTable::getInstance(); });
+        bench.run("startup/structures",
+                  []
+                  {
+                      StructureRegistry::clear();
+                      for (auto& shape : SHAPES)
+                          StructureRegistry::find(shape.name);
+                  });
+        if (vm.count("tool"))
+        {
+#ifdef _WIN32
+            auto command = std::format("\"\"{}\" --hash bench >NUL\"", vm["tool"].as<std::string>());
+#else
+            auto command = std::format("\"{}\" --hash bench >/dev/null", vm["tool"].as<std::string>());
+#endif
+            bench.run("startup/process", [&] { std::system(command.c_str()); });
+        }
+
+        Generator generator(42);
+
+        for (auto& shape : SHAPES)
+        {
+            auto structure = StructureRegistry::find(shape.name);
+            if (!structure) throw std::runtime_error(std::format("Structure {} not found.", shape.structure));
+
+            auto file = generateFile(generator, *structure, shape.rows * scale);
+            benchmarkFile(bench, shape, file, workPath);
+        }
+
+        benchmarkHashes(bench, generator.getWords(), scale);
+        std::filesystem::remove_all(workPath);
+        workPath.clear();
+
+        auto json           = bench.toJSON();
+        json["scale"]       = scale;
+        json["hashBackend"] = getHashBackendName(getHashBackend());
+
+        if (vm.count("output"))
+        {
+            std::ofstream output(vm["output"].as<std::string>());
+            pretty_print(output, json);
+        }
+        else
+            pretty_print(std::cout, json);
+    }
+    catch (std::exception& e)
+    {
+        std::cout << e.what() << std::endl;
+
+        std::error_code error;
+        if (!workPath.empty()) std::filesystem::remove_all(workPath, error);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,21 @@
+#include "Profiler.hpp"
+
+#include <cstdlib>
+#include <new>
+
+/*
+ * Replaces the global operator new of DWNOTools to count allocations for --stats.
+ * Only linked into the executable, programs using dwno_csvb keep their own allocator. Kept apart from the callers, so
+ * the compiler doesn't pair the malloc and free below with new and delete expressions.
+ */
+#ifdef DWNO_PROFILING
+void* operator new(std::size_t size)
+{
+    Profiler::countAllocation(size);
+    if (auto* ptr = std::malloc(size == 0 ? 1 : size)) return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, std::size_t) noexcept { std::free(ptr); }
+#endif
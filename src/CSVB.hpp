@@ -1,48 +1,22 @@
 #pragma once
 
-#include "parser.hpp"
+#include "DataTypes.hpp"
+#include "MappedFile.hpp"
+#include "PackManifest.hpp"
 
 #include <boost/json.hpp>
 
+#include <cstddef>
 #include <cstdint>
+#include <cstring>
 #include <filesystem>
 #include <map>
+#include <span>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
-enum class DataType : uint32_t
-{
-    DUMMY        = 0x00,
-    STRING       = 0x01,
-    INT32        = 0x02,
-    FLOAT        = 0x03,
-    FLAG         = 0x04,
-    INT16        = 0x05,
-    INT8         = 0x06,
-    VSTRING      = 0x07,
-    FX32         = 0x08,
-    STRING16     = 0x09,
-    DEF_INT32    = 0x0A,
-    DEF_FX32     = 0x0B,
-    DEF_STRING   = 0x0C,
-    VSTRING_UTF  = 0x0D,
-    STRING4      = 0x0E,
-    STRING8      = 0x0F,
-    STRING12     = 0x10,
-    DEF_STRING4  = 0x11,
-    DEF_STRING8  = 0x12,
-    DEF_STRING12 = 0x13,
-    DEF_STRING16 = 0x14,
-    CHAR4        = 0x15,
-    CHAR8        = 0x16,
-    DEF_CHAR4    = 0x17,
-    DEF_CHAR8    = 0x18,
-    HASH32       = 0x19,
-    DEF_HASH32   = 0x1A,
-    VSTRING_UTF8 = 0x1B,
-    DEF_SHORT    = 0x1C
-};
-
 struct CSVBHeader
 {
     uint32_t magic;
@@ -55,6 +29,30 @@ struct CSVBHeader
     uint32_t unkOffset3; // mappingAddr
 };
 
+/*
+ * Header of the variable data sections as extracted next to the CSVs.
+ * The layout of vForm and vData isn't known yet, so everything behind the string section is kept as it is and
+ * only relocated when packing. Offsets are relative to the start of vForm.
+ * The sections may point into the data and string sections, so packing requires those to keep the size they were
+ * extracted with.
+ */
+struct VariableDataHeader
+{
+    static constexpr uint32_t MAGIC            = 'VSEC';
+    static constexpr uint32_t VERSION          = 2;
+    static constexpr uint32_t NO_MAPPING       = 0xFFFFFFFF;
+    static constexpr uint32_t ABSOLUTE_MAPPING = 1; // mappingAddr points in front of vForm and is kept as it is
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t flags;
+    uint32_t vDataOffset;
+    uint32_t mappingOffset;
+    uint32_t vFormOffset; // of the extracted file, from its start
+    uint32_t dataSize;    // of the extracted file's data section, padding included
+    uint32_t stringSize;  // of the extracted file's string section, padding included
+};
+
 struct CSVBTable
 {
     char name[16];
@@ -66,63 +64,234 @@ struct CSVBTable
     uint32_t dataOffset;
 
 public:
-    std::string name_str() { return std::string(name); }
+    std::string name_str() const { return std::string(name, strnlen(name, sizeof(name))); }
+};
+
+// the in-memory APIs take bytes, the views below work on chars
+inline std::span<const char> asChars(std::span<const std::byte> data)
+{
+    return { reinterpret_cast<const char*>(data.data()), data.size() };
+}
+
+/*
+ * Read-only, bounds checked view of a CSVB file in memory.
+ * All offsets are validated once on construction, accessors hand out pointers into the viewed memory.
+ */
+class CSVBView
+{
+public:
+    class Row
+    {
+        const char* ptr;
+
+    public:
+        Row(const char* ptr)
+            : ptr(ptr)
+        {
+        }
+
+        const char* data() const { return ptr; }
+
+        template<typename T>
+        T get(std::size_t offset) const
+        {
+            T value;
+            std::memcpy(&value, ptr + offset, sizeof(T));
+            return value;
+        }
+    };
+
+    class Table
+    {
+        const CSVBView* view;
+        const CSVBTable* table;
+
+    public:
+        Table(const CSVBView* view, const CSVBTable* table)
+            : view(view)
+            , table(table)
+        {
+        }
+
+        const CSVBTable& raw() const { return *table; }
+        std::string name() const { return table->name_str(); }
+        uint32_t flag() const { return table->flag; }
+        uint32_t entryCount() const { return table->entryCount; }
+        uint32_t entrySize() const { return table->entrySize; }
+        uint32_t fieldCount() const { return table->fieldCount; }
+        std::span<const DataType> types() const;
+        Row row(uint32_t index) const { return view->data.data() + table->dataOffset + table->entrySize * index; }
+    };
+
+private:
+    std::span<const char> data;
+    CSVBHeader header{};
+    std::span<const CSVBTable> tables;
+    std::size_t stringEnd = 0;
+    bool valid            = false;
+
+private:
+    void validate();
+
+public:
+    CSVBView() = default;
+    // throws std::runtime_error if a CSVB file points outside of the given data
+    CSVBView(std::span<const char> data);
+
+    bool isValid() const { return valid; }
+    const CSVBHeader& getHeader() const { return header; }
+    std::size_t tableCount() const { return tables.size(); }
+    Table table(std::size_t index) const { return { this, &tables[index] }; }
+    // NUL terminated string at the given offset of the string section
+    std::string_view string(uint32_t offset) const;
+    // whether the file has variable data sections, see VariableDataHeader
+    bool hasVariableData() const;
+    // everything from vForm to the end of the file
+    std::span<const char> variableData() const { return data.subspan(stringEnd); }
+    // header of the extracted variable data, throws std::runtime_error if vData lies outside of it
+    VariableDataHeader variableDataHeader() const;
+};
+
+class ColumnarTable;
+class CSVWriter;
+struct Structure;
+struct TableStructure;
+
+struct FieldCodec
+{
+    DataType type;
+    uint32_t offset;
+    uint32_t size;
+};
+
+/*
+ * Flat row layout of a table, compiled once from its field types.
+ * Replaces the per-field type and size lookups in the export and import loops.
+ */
+class RowCodec
+{
+    std::vector<FieldCodec> fields;
+    uint32_t rowSize = 0;
+
+public:
+    RowCodec() = default;
+    RowCodec(std::span<const DataType> types);
+
+    auto begin() const { return fields.begin(); }
+    auto end() const { return fields.end(); }
+    const FieldCodec& operator[](std::size_t index) const { return fields[index]; }
+    std::size_t fieldCount() const { return fields.size(); }
+    uint32_t size() const { return rowSize; }
 };
 
 class CSVBExporter
 {
-    CSVBHeader header;
-    std::vector<CSVBTable> tables;
-    std::unique_ptr<char[]> data;
-    std::map<std::string, std::vector<DataType>> types;
+    MappedFile file;
+    CSVBView view;
+    std::vector<RowCodec> codecs; // by table index
     std::string fileName;
 
     boost::json::object structure;
     bool valid;
+    bool columnar    = false;
+    std::size_t jobs = 1;
 
 private:
+    void load(const std::filesystem::path& source);
     bool buildStructure();
-    std::string convertType(DataType type, char* ptr);
+    std::filesystem::path getTablePath(const std::filesystem::path& folder, std::size_t table);
+    void writeRows(std::size_t table, uint32_t begin, uint32_t end, CSVWriter& output) const;
+    void writeTablesParallel(const std::filesystem::path& folder);
+    void writeVariableData(std::filesystem::path outPath);
 
 public:
     CSVBExporter(std::filesystem::path input);
+    // views a CSVB file in memory, which must outlive the exporter, source selects its name and structure
+    CSVBExporter(std::span<const std::byte> data, std::filesystem::path source);
     void writeStructureJSON(std::filesystem::path outPath);
-    void write(std::filesystem::path output);
+    void write(std::filesystem::path output, bool writeRawStructure = true);
+    std::filesystem::path getRawStructurePath();
+
+    const CSVBView& getView() const { return view; }
+    const boost::json::object& getStructure() const { return structure; }
+    std::vector<std::string> getColumnNames(std::size_t table);
+    // writes a table as CSV, header included
+    void writeTable(std::size_t table, CSVWriter& output);
+    std::vector<char> encodeColumnar(std::size_t table);
+    // header of variable.bin, followed by getView().variableData() in the file
+    VariableDataHeader getVariableDataHeader() const;
 
     void setStructure(boost::json::object obj);
+    // write tables as ColumnarTable instead of CSV
+    void setColumnar(bool value) { columnar = value; }
+    // threads write() formats the tables and row ranges of the file with, 0 uses all cores
+    void setJobs(std::size_t value) { jobs = value; }
     bool isValid();
     void hashStrings();
+
+    static constexpr const char* VARIABLE_DATA_FILE = "variable.bin";
+    // rows formatted by one task when writing in parallel
+    static constexpr uint32_t ROWS_PER_TASK = 4096;
 };
 
-struct StringBlock
+/*
+ * Interned strings of a string section.
+ * Every distinct string is stored once in a single arena, in order of insertion, zero terminated and 4 byte aligned.
+ * Lookups hash the string once and probe an open addressing table. With mergeSuffixes a string that ends another
+ * one is stored as the tail of that string instead, see layout().
+ */
+class StringBlock
 {
-private:
-    std::map<std::string, std::size_t> strings;
-    std::size_t lastOffset = 0;
+    struct Slot
+    {
+        uint32_t hash;
+        uint32_t index; // entry index + 1, 0 marks an empty slot
+    };
 
-public:
-    std::size_t add(std::string string)
+    struct Entry
     {
-        if (strings.contains(string)) return strings[string];
+        uint32_t offset;
+        uint32_t length;
+    };
+
+    std::vector<char> arena;
+    std::vector<Entry> entries;
+    std::vector<Slot> slots;
+    bool mergeSuffixes;
 
-        auto retVal     = lastOffset;
-        strings[string] = lastOffset;
-        lastOffset += (string.size() + 4) & ~3;
+    // final layout when merging suffixes
+    std::vector<char> merged;
+    std::vector<uint32_t> mergedOffsets; // by entry index
 
-        return retVal;
-    }
+private:
+    std::string_view get(const Entry& entry) const { return { arena.data() + entry.offset, entry.length }; }
+    std::size_t find(uint32_t offset) const;
+    void grow();
+
+public:
+    StringBlock(bool mergeSuffixes = false);
 
-    std::size_t totalSize() { return lastOffset + (0x10 - (lastOffset % 0x10) % 0x10); }
-    auto begin() { return strings.begin(); }
-    auto end() { return strings.end(); }
+    // offset of the string in insertion order, the final one is given by resolve()
+    uint32_t add(std::string_view string);
+    // lays out merged strings, to be called once all strings were added
+    void layout();
+    uint32_t resolve(uint32_t offset) const;
+    // the string added at offset
+    std::string_view at(uint32_t offset) const { return get(entries[find(offset)]); }
+    bool mergesSuffixes() const { return mergeSuffixes; }
+
+    std::size_t totalSize() const;
+    // writes the string section of totalSize() bytes
+    void copyTo(char* dest) const;
 };
 
 struct ImporterEntry
 {
     std::string name;
-    std::vector<uint32_t> data;
     std::vector<DataType> datatypes;
+    RowCodec codec;
     CSVBTable table;
+    std::size_t dataBegin; // offset of the table's rows in CSVBImporter::data
 };
 
 class CSVBImporter
@@ -131,13 +300,53 @@ private:
     CSVBHeader header{};
     StringBlock strings;
     std::vector<ImporterEntry> entries;
+    std::vector<uint8_t> data;          // data section, rows of all tables back to back
+    MappedFile variableFile;            // variable.bin when packing a folder
+    std::span<const char> variableData; // extracted variable data sections, if any
+
+    // the packed file besides the data section, see finish()
+    std::vector<char> head;         // header and table list
+    std::vector<char> tail;         // padding, structure and string sections
+    std::span<const char> variable; // variable data sections without their header
+    bool finished = false;
+
+    // incremental packing, see PackManifest
+    const PackManifest* previous = nullptr;
+    std::vector<TableSnapshot> snapshots;
 
-    uint32_t convertValue(std::string type, std::string value);
+    ImporterEntry& addEntry(const TableStructure& table);
+    void readTable(ImporterEntry& entry, std::string_view csv);
+    void readColumnar(ImporterEntry& entry, const ColumnarTable& columns);
+    // CSV text or a columnar table
+    void readTableData(ImporterEntry& entry, std::span<const char> data);
+    void readTableIncremental(ImporterEntry& entry, const std::filesystem::path& path);
+    void restoreTable(ImporterEntry& entry, const TableSnapshot& snapshot);
+    TableSnapshot captureTable(const ImporterEntry& entry) const;
+
+    // finalizes the string offsets and assembles all sections but the data, once
+    void finish();
 
 public:
-    CSVBImporter(std::filesystem::path inputPath);
+    // CSV text or columnar table of each table by name, tables without an entry are packed empty
+    using TableSources = std::unordered_map<std::string, std::span<const std::byte>>;
+
+    // with a previous manifest, tables whose CSV is unchanged are restored from it and snapshots are recorded
+    CSVBImporter(std::filesystem::path inputPath, bool mergeStrings = false, const PackManifest* previous = nullptr);
+    // packs tables held in memory, which only has to stay valid until the importer is destroyed
+    CSVBImporter(const Structure& structure,
+                 const TableSources& tables,
+                 std::span<const std::byte> variableData = {},
+                 bool mergeStrings                       = false);
 
+    // size of the packed file
+    std::size_t packedSize();
     void write(std::filesystem::path outputPath);
+    // writes the packed file to the start of buffer, which must hold at least packedSize() bytes
+    std::size_t writeTo(std::span<std::byte> buffer);
+    std::vector<TableSnapshot>& getSnapshots() { return snapshots; }
+
+    // the CSV of a table, or its columnar file if there is no CSV
+    static std::filesystem::path getTablePath(const std::filesystem::path& folder, const std::string& name);
 };
 
 DataType convertToType(std::string type);
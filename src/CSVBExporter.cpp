@@ -1,98 +1,125 @@
 #include "CSVB.hpp"
+#include "CSVWriter.hpp"
+#include "ColumnarTable.hpp"
+#include "Profiler.hpp"
+#include "ThreadPool.hpp"
 #include "utils.hpp"
 
+#include <algorithm>
+#include <format>
 #include <fstream>
 #include <iostream>
 
-CSVBExporter::CSVBExporter(std::filesystem::path inputPath)
+namespace
 {
-    const auto length = std::filesystem::file_size(inputPath);
+    // "0x" and the hex of every byte, see CSVBImporter for the other direction
+    std::string formatInlineBytes(std::string_view bytes)
+    {
+        std::string text = "0x";
+        for (auto byte : bytes)
+            text += std::format("{:02x}", static_cast<uint8_t>(byte));
+        return text;
+    }
 
-    std::ifstream input(inputPath, std::ios::in | std::ios::binary);
-    data = std::make_unique<char[]>(length);
+    template<DataType TYPE>
+    struct ExportField
+    {
+        static void apply(CSVWriter& output, const char* ptr, const CSVBView& view)
+        {
+            constexpr auto traits = getTypeTraits(TYPE);
+            CSVBView::Row row(ptr);
+
+            if constexpr (traits.kind == FieldKind::INTEGER)
+                output.writeInt(row.get<IntegerOf<traits.size>>(0));
+            else if constexpr (traits.kind == FieldKind::FLOAT)
+                output.writeFloat(row.get<float>(0));
+            else if constexpr (traits.kind == FieldKind::FIXED)
+                output.writeDouble(row.get<int32_t>(0) / 4096.0);
+            else if constexpr (traits.kind == FieldKind::HASH)
+            {
+                uint32_t hash = row.get<uint32_t>(0);
+                auto name     = RainbowTable::reverseHash(hash);
+                if (name)
+                    output.writeString(*name);
+                else
+                    output.writeHex(hash);
+            }
+            else if constexpr (traits.kind == FieldKind::STRING_REF)
+                output.writeString(view.string(row.get<uint32_t>(0)));
+            else if constexpr (traits.kind == FieldKind::INLINE_STRING)
+            {
+                // text up to the first NUL if everything behind it is padding, otherwise the raw bytes
+                std::string_view text(ptr, traits.size);
+                auto end = text.find('\0');
+                if (end == std::string_view::npos || text.find_first_not_of('\0', end) == std::string_view::npos)
+                    output.writeString(text.substr(0, end));
+                else
+                    output.writeString(formatInlineBytes(text));
+            }
+            else
+                throw std::invalid_argument(std::format("Didn't deal with {}", traits.name));
+        }
+    };
 
-    input.read(data.get(), length);
+    constexpr auto FIELD_WRITERS = makeCodecTable<ExportField>();
+} // namespace
 
-    header = *reinterpret_cast<CSVBHeader*>(data.get());
+CSVBExporter::CSVBExporter(std::filesystem::path inputPath)
+    : file(inputPath)
+    , view(file.data())
+{
+    load(inputPath);
+}
+
+CSVBExporter::CSVBExporter(std::span<const std::byte> data, std::filesystem::path source)
+    : view(asChars(data))
+{
+    load(source);
+}
 
-    if (header.magic != 'BVSC' || header.magicVersion != '3.4v')
+void CSVBExporter::load(const std::filesystem::path& source)
+{
+    if (!view.isValid())
     {
         valid = false;
         return;
     }
 
-    for (uint32_t i = 0u; i < header.tableCount; i++)
-        tables.push_back(reinterpret_cast<CSVBTable*>(data.get() + sizeof(CSVBHeader))[i]);
-
-    fileName = inputPath.filename().string();
+    fileName = source.filename().string();
 
     valid = buildStructure();
-    setStructure(getStructureFile(inputPath));
+    setStructure(getStructureFile(source));
 }
 
 bool CSVBExporter::isValid() { return valid; }
 
 void CSVBExporter::hashStrings()
 {
-    for (auto& entry : tables)
+    for (std::size_t t = 0; t < view.tableCount(); t++)
     {
-        for (uint32_t i = 0u; i < entry.entryCount; i++)
-        {
-            char* entryData = data.get() + entry.dataOffset + entry.entrySize * i;
-
-            for (uint32_t i = 0u; i < entry.fieldCount; i++)
-            {
-                auto type = types[entry.name_str()][i];
-                if (type == DataType::VSTRING_UTF8)
-                {
-                    auto offset = *reinterpret_cast<uint32_t*>(entryData);
-                    auto string = std::string(data.get() + header.stringOffset + offset);
-                    RainbowTable::addHash(string);
-                }
-                entryData += static_cast<uint32_t>(getDataTypeSize(type));
-            }
-        }
-    }
-}
+        auto entry = view.table(t);
 
-std::string CSVBExporter::convertType(DataType type, char* ptr)
-{
-    switch (type)
-    {
-        case DataType::INT32: return std::to_string(*reinterpret_cast<int32_t*>(ptr));
-        case DataType::DEF_INT32: return std::to_string(*reinterpret_cast<int32_t*>(ptr)); // enum?
-        case DataType::FLOAT: return std::to_string(*reinterpret_cast<float*>(ptr));
-        case DataType::HASH32:
-        case DataType::DEF_HASH32:
+        for (uint32_t i = 0u; i < entry.entryCount(); i++)
         {
-            uint32_t hash = *reinterpret_cast<uint32_t*>(ptr);
-            std::stringstream sstream;
-            sstream << std::quoted(RainbowTable::reverseHash(hash).value_or(std::format("{:x}", hash)), '\"', '\"');
-            return sstream.str();
-        }
-        case DataType::VSTRING_UTF8:
-        {
-            auto offset = *reinterpret_cast<uint32_t*>(ptr);
-            auto string = std::string(data.get() + header.stringOffset + offset);
-            std::stringstream sstream;
-            sstream << std::quoted(string, '\"', '\"');
-            return sstream.str();
-        }
+            auto row = entry.row(i);
 
-        default: throw std::invalid_argument("Didn't deal with " + std::to_string((int32_t)type));
+            for (auto& field : codecs[t])
+                if (isStringRefType(field.type))
+                    RainbowTable::addHash(std::string(view.string(row.get<uint32_t>(field.offset))));
+        }
     }
-
-    return "INVALID";
 }
 
 bool CSVBExporter::buildStructure()
 {
-    for (auto& entry : tables)
+    PROFILE_SCOPE("build structure");
+
+    for (std::size_t t = 0; t < view.tableCount(); t++)
     {
+        auto& entry = view.table(t).raw();
         boost::json::array arr;
         boost::json::object obj;
-        std::vector<DataType> typeVec;
-        DataType* typeLists = reinterpret_cast<DataType*>(data.get() + header.structureOffset + entry.structureOffset);
+        auto typeLists = view.table(t).types();
 
         for (uint32_t i = 0u; i < entry.fieldCount; i++)
         {
@@ -102,15 +129,12 @@ bool CSVBExporter::buildStructure()
             a["name"] = getTypeName(type, i);
             a["type"] = getTypeKey(type);
             arr.push_back(a);
-            typeVec.push_back(type);
         }
 
         obj["flag"]                 = entry.flag;
         obj["structure"]            = arr;
         structure[entry.name_str()] = obj;
-        types[entry.name_str()]     = typeVec;
-
-        if (entry.flag & 1) return false; // TODO file contains variable CSVB, unsupported
+        codecs.emplace_back(typeLists);
     }
 
     return true;
@@ -126,10 +150,14 @@ void CSVBExporter::writeStructureJSON(std::filesystem::path outPath)
     pretty_print(jsonOutput, structure);
 }
 
-void CSVBExporter::write(std::filesystem::path outPath)
+std::filesystem::path CSVBExporter::getRawStructurePath() { return (getRawStructuresPath() / fileName).concat(".json"); }
+
+void CSVBExporter::write(std::filesystem::path outPath, bool writeRawStructure)
 {
     if (!isValid()) return;
 
+    PROFILE_SCOPE("export file");
+
     if (!std::filesystem::exists(outPath))
     {
         if (outPath.has_parent_path()) std::filesystem::create_directories(outPath);
@@ -137,44 +165,171 @@ void CSVBExporter::write(std::filesystem::path outPath)
     else if (!std::filesystem::is_directory(outPath))
         throw std::invalid_argument("Error: target path is not a directory.");
 
-    for (auto& entry : tables)
+    uint64_t rowCount = 0;
+    for (std::size_t t = 0; t < view.tableCount(); t++)
+        rowCount += view.table(t).entryCount();
+
+    if (jobs != 1 && rowCount > ROWS_PER_TASK)
+        writeTablesParallel(outPath / fileName);
+    else
     {
-        std::filesystem::path path = (outPath / fileName / entry.name_str()).concat(".csv");
-        if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path());
+        for (std::size_t t = 0; t < view.tableCount(); t++)
+        {
+            auto path = getTablePath(outPath / fileName, t);
+
+            if (columnar)
+            {
+                ColumnarTable::write(path, view, t, codecs[t], getColumnNames(t));
+                continue;
+            }
+
+            std::ofstream stream(path, std::ios::out | std::ios::binary);
+            CSVWriter output(stream);
+            writeTable(t, output);
+        }
+    }
 
-        std::ofstream output(path);
+    if (view.hasVariableData()) writeVariableData(outPath / fileName / VARIABLE_DATA_FILE);
+    if (writeRawStructure) writeStructureJSON(getRawStructurePath());
+}
 
-        bool first = true;
-        for (uint32_t i = 0u; i < entry.fieldCount; i++)
+std::filesystem::path CSVBExporter::getTablePath(const std::filesystem::path& folder, std::size_t table)
+{
+    auto extension             = columnar ? ColumnarTable::EXTENSION : ".csv";
+    std::filesystem::path path = (folder / view.table(table).name()).concat(extension);
+    if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path());
+    return path;
+}
+
+void CSVBExporter::writeTablesParallel(const std::filesystem::path& folder)
+{
+    // every table is cut into row ranges formatted by separate tasks, then the ranges are written in order
+    struct TableOutput
+    {
+        std::filesystem::path path;
+        std::vector<std::string> parts; // header, then one per row range
+    };
+
+    std::vector<TableOutput> outputs(view.tableCount());
+    ThreadPool pool(jobs);
+
+    for (std::size_t t = 0; t < view.tableCount(); t++)
+    {
+        auto& output = outputs[t];
+        output.path  = getTablePath(folder, t);
+
+        if (columnar)
         {
-            if (first)
-                first = false;
-            else
-                output << ",";
-            output << structure[entry.name_str()].as_object()["structure"].as_array()[i].as_object()["name"];
+            pool.submit([this, t, &output, names = getColumnNames(t)]
+                        { ColumnarTable::write(output.path, view, t, codecs[t], names); });
+            continue;
         }
-        output << std::endl;
 
-        for (uint32_t i = 0u; i < entry.entryCount; i++)
+        CSVWriter header;
+        for (auto& name : getColumnNames(t))
+            header.writeString(name);
+        header.endRow();
+
+        const uint32_t rows   = view.table(t).entryCount();
+        const uint32_t ranges = std::max(1u, (rows + ROWS_PER_TASK - 1) / ROWS_PER_TASK);
+        output.parts.resize(ranges + 1);
+        output.parts[0] = header.release();
+
+        for (uint32_t i = 0; i < ranges; i++)
         {
-            char* entryData = data.get() + entry.dataOffset + entry.entrySize * i;
+            pool.submit(
+                [this, t, i, rows, &output]
+                {
+                    CSVWriter writer;
+                    writeRows(t, i * ROWS_PER_TASK, std::min(rows, (i + 1) * ROWS_PER_TASK), writer);
+                    output.parts[i + 1] = writer.release();
+                });
+        }
+    }
+    pool.wait();
+
+    if (columnar) return;
 
-            bool first2 = true;
-            for (uint32_t i = 0u; i < entry.fieldCount; i++)
+    for (auto& output : outputs)
+    {
+        pool.submit(
+            [&output]
             {
-                if (first2)
-                    first2 = false;
-                else
-                    output << ",";
+                std::ofstream stream(output.path, std::ios::out | std::ios::binary);
+                for (auto& part : output.parts)
+                    stream.write(part.data(), part.size());
+                if (!stream) throw std::runtime_error("Error: failed to write " + output.path.string());
+            });
+    }
+    pool.wait();
+}
 
-                output << convertType(types[entry.name_str()][i], entryData);
-                entryData += static_cast<uint32_t>(getDataTypeSize(types[entry.name_str()][i]));
-            }
-            output << std::endl;
-        }
+std::vector<std::string> CSVBExporter::getColumnNames(std::size_t table)
+{
+    auto& columns = structure[view.table(table).name()].as_object()["structure"].as_array();
+
+    std::vector<std::string> names;
+    for (uint32_t i = 0u; i < view.table(table).fieldCount(); i++)
+        names.emplace_back(columns[i].as_object()["name"].as_string());
+    return names;
+}
+
+void CSVBExporter::writeTable(std::size_t table, CSVWriter& output)
+{
+    for (auto& name : getColumnNames(table))
+        output.writeString(name);
+    output.endRow();
+
+    writeRows(table, 0, view.table(table).entryCount(), output);
+}
+
+void CSVBExporter::writeRows(std::size_t table, uint32_t begin, uint32_t end, CSVWriter& output) const
+{
+    PROFILE_SCOPE("format rows");
+
+    auto source = view.table(table);
+    auto& codec = codecs[table];
+    PROFILE_COUNT(std::format("rows exported: {}", source.name()), end - begin);
+    PROFILE_COUNT(std::format("bytes exported: {}", source.name()), uint64_t(end - begin) * source.entrySize());
+
+    for (uint32_t i = begin; i < end; i++)
+    {
+        const char* entryData = source.row(i).data();
+
+        for (auto& field : codec)
+            FIELD_WRITERS[static_cast<uint32_t>(field.type)](output, entryData + field.offset, view);
+        output.endRow();
+    }
+}
+
+std::vector<char> CSVBExporter::encodeColumnar(std::size_t table)
+{
+    return ColumnarTable::encode(view, table, codecs[table], getColumnNames(table));
+}
+
+VariableDataHeader CSVBExporter::getVariableDataHeader() const
+{
+    try
+    {
+        return view.variableDataHeader();
     }
+    catch (std::runtime_error& e)
+    {
+        throw std::runtime_error(std::format("{}: {}", fileName, e.what()));
+    }
+}
 
-    writeStructureJSON((getRawStructuresPath() / fileName).concat(".json"));
+void CSVBExporter::writeVariableData(std::filesystem::path outPath)
+{
+    auto varHeader = getVariableDataHeader();
+    auto variable  = view.variableData();
+
+    // written straight from the mapped file, the sections are never expanded in memory
+    std::filesystem::create_directories(outPath.parent_path());
+    std::ofstream output(outPath, std::ios::out | std::ios::binary);
+    output.write(reinterpret_cast<const char*>(&varHeader), sizeof(varHeader));
+    output.write(variable.data(), variable.size());
+    if (!output) throw std::runtime_error("Error: failed to write " + outPath.string());
 }
 
 void CSVBExporter::setStructure(boost::json::object obj)
@@ -1,177 +1,532 @@
 #include "CSVB.hpp"
+#include "CSVReader.hpp"
+#include "ColumnarTable.hpp"
+#include "Profiler.hpp"
+#include "StructureRegistry.hpp"
 #include "utils.hpp"
 
-#include <parser.hpp>
-
-CSVBImporter::CSVBImporter(std::filesystem::path inputPath)
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <limits>
+#include <unordered_map>
+
+CSVBImporter::CSVBImporter(std::filesystem::path inputPath, bool mergeStrings, const PackManifest* previous)
+    : strings(mergeStrings)
+    , previous(previous)
 {
     if (!std::filesystem::exists(inputPath)) throw std::invalid_argument("Error: input path does not exist.");
     if (!std::filesystem::is_directory(inputPath)) throw std::invalid_argument("Error: input path is not a directory.");
 
-    auto structure = getStructureFile(inputPath, true);
+    auto structure = StructureRegistry::find(inputPath, true);
 
-    if (structure.size() == 0) throw std::runtime_error("No structure found. Aborting.");
+    if (!structure || structure->tables.empty()) throw std::runtime_error("No structure found. Aborting.");
 
     strings.add("");
 
-    for (auto& table : structure)
+    for (auto& table : structure->tables)
     {
-        ImporterEntry entry{};
-        std::string name        = table.key();
-        boost::json::object obj = table.value().as_object();
-        boost::json::array arr  = obj["structure"].as_array();
-        entry.name              = name;
-        entry.table.flag        = static_cast<uint32_t>(obj["flag"].as_int64());
-
-        std::copy(name.begin(), name.end(), std::begin(entry.table.name));
+        auto& entry = addEntry(table);
 
-        // data types / structure
-        for (auto& dType : arr)
+        auto path = getTablePath(inputPath, table.name);
+        if (previous)
+            readTableIncremental(entry, path);
+        else if (std::filesystem::exists(path))
         {
-            std::string str(dType.as_object()["type"].as_string());
-            DataType type = convertToType(str);
-            entry.datatypes.push_back(type);
-            entry.table.entrySize += static_cast<uint32_t>(getDataTypeSize(type));
-            entry.table.fieldCount++;
+            MappedFile file(path);
+            readTableData(entry, file.data());
         }
+    }
 
-        // read csv data
-        {
-            std::ifstream ifstr((inputPath / name).concat(".csv"));
-            aria::csv::CsvParser parser(ifstr);
+    auto variablePath = inputPath / CSVBExporter::VARIABLE_DATA_FILE;
+    if (std::filesystem::is_regular_file(variablePath))
+    {
+        variableFile = MappedFile(variablePath);
+        variableData = variableFile.data();
+    }
+}
 
-            auto& entryStruct = arr;
-            auto rowId        = -1;
-            for (auto& row : parser)
-            {
-                // skip header
-                if (++rowId == 0) continue;
+CSVBImporter::CSVBImporter(const Structure& structure,
+                           const TableSources& tables,
+                           std::span<const std::byte> variable,
+                           bool mergeStrings)
+    : strings(mergeStrings)
+    , variableData(asChars(variable))
+{
+    if (structure.tables.empty()) throw std::runtime_error("No structure found. Aborting.");
 
-                auto colId = 0;
+    strings.add("");
 
-                for (auto& col : row)
-                {
-                    auto& obj = entryStruct[colId++].as_object();
-                    std::string type(obj["type"].as_string());
+    for (auto& table : structure.tables)
+    {
+        auto& entry = addEntry(table);
 
-                    entry.data.push_back(convertValue(type, col));
-                }
-            }
+        auto itr = tables.find(table.name);
+        if (itr != tables.end()) readTableData(entry, asChars(itr->second));
+    }
+}
 
-            entry.table.entryCount = rowId;
-        }
+ImporterEntry& CSVBImporter::addEntry(const TableStructure& table)
+{
+    ImporterEntry& entry = entries.emplace_back();
+    entry.name           = table.name;
+    entry.table.flag     = table.flag;
 
-        entries.push_back(entry);
-    }
+    std::copy(table.name.begin(), table.name.end(), std::begin(entry.table.name));
+
+    entry.datatypes        = table.types;
+    entry.codec            = table.codec;
+    entry.table.entrySize  = entry.codec.size();
+    entry.table.fieldCount = static_cast<uint32_t>(entry.codec.fieldCount());
+    entry.dataBegin        = data.size();
+
+    return entry;
 }
 
-uint32_t CSVBImporter::convertValue(std::string type, std::string value)
+namespace
 {
-    DataType dataType = convertToType(type);
+    // behaves like std::stoi/std::stof: leading whitespace and trailing garbage are ignored
+    template<typename T>
+    T parseNumber(std::string_view value)
+    {
+        while (!value.empty() && std::isspace(static_cast<unsigned char>(value.front())))
+            value.remove_prefix(1);
+        if (value.starts_with('+')) value.remove_prefix(1);
+
+        T result{};
+        auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), result);
+        if (ec == std::errc::invalid_argument) throw std::invalid_argument(std::format("'{}' is not a number", value));
+        if (ec == std::errc::result_out_of_range) throw std::out_of_range(std::format("'{}' is out of range", value));
 
-    switch (dataType)
+        return result;
+    }
+
+    template<typename T>
+    void store(uint8_t* dest, T value)
     {
-        case DataType::DEF_INT32:
-        case DataType::INT32:
-        {
-            auto val1 = std::stoi(value.c_str());
-            return *reinterpret_cast<uint32_t*>(&val1);
-        }
-        case DataType::FLOAT:
-        {
-            auto val2 = std::stof(value.c_str());
-            return *reinterpret_cast<uint32_t*>(&val2);
-        }
-        case DataType::HASH32:
-        case DataType::DEF_HASH32:
+        std::memcpy(dest, &value, sizeof(T));
+    }
+
+    template<DataType TYPE>
+    struct ImportField
+    {
+        static void apply(std::string_view value, uint8_t* dest, StringBlock& strings)
         {
-            auto length = value.length();
-            auto hash   = makeHash(value);
+            constexpr auto traits = getTypeTraits(TYPE);
 
-            if (length >= 6 && length <= 8)
+            if constexpr (traits.kind == FieldKind::INTEGER)
+                store(dest, parseNumber<IntegerOf<traits.size>>(value));
+            else if constexpr (traits.kind == FieldKind::FLOAT)
+                store(dest, parseNumber<float>(value));
+            else if constexpr (traits.kind == FieldKind::FIXED)
             {
-                try
+                auto fixed = std::llround(parseNumber<double>(value) * 4096.0);
+                if (fixed < std::numeric_limits<int32_t>::min() || fixed > std::numeric_limits<int32_t>::max())
+                    throw std::out_of_range(std::format("'{}' is out of range", value));
+                store(dest, static_cast<int32_t>(fixed));
+            }
+            else if constexpr (traits.kind == FieldKind::HASH)
+            {
+                auto length = value.length();
+                auto hash   = makeHash(value);
+
+                // Hex-looking names the dictionary knows were exported by name and stay names.
+                if (length >= 6 && length <= 8)
                 {
-                    hash = std::stoul(value.c_str(), nullptr, 16);
+                    uint32_t hex;
+                    auto result = std::from_chars(value.data(), value.data() + length, hex, 16);
+                    if (result.ec == std::errc() && result.ptr == value.data() + length)
+                    {
+                        auto name = RainbowTable::reverseHash(hash);
+                        if (!name || *name != value) hash = hex;
+                    }
                 }
-                catch (std::exception& e)
+
+                store(dest, hash);
+            }
+            else if constexpr (traits.kind == FieldKind::STRING_REF)
+                store(dest, strings.add(value));
+            else if constexpr (traits.kind == FieldKind::INLINE_STRING)
+            {
+                // raw bytes are written as "0x" and two hex digits per byte, which is too long to be text
+                if (value.size() == 2 + 2 * traits.size && value.starts_with("0x"))
                 {
+                    for (std::size_t i = 0; i < traits.size; i++)
+                    {
+                        auto digits = value.data() + 2 + 2 * i;
+                        auto result = std::from_chars(digits, digits + 2, dest[i], 16);
+                        if (result.ec != std::errc() || result.ptr != digits + 2)
+                            throw std::invalid_argument(std::format("'{}' is not a valid byte string", value));
+                    }
+                    return;
                 }
+
+                if (value.size() > traits.size)
+                    throw std::out_of_range(std::format("'{}' is longer than {} bytes", value, traits.size));
+                std::memcpy(dest, value.data(), value.size());
+                std::memset(dest + value.size(), 0, traits.size - value.size());
             }
+            else
+                throw std::invalid_argument(std::format("Didn't deal with {}", traits.name));
+        }
+    };
+
+    constexpr auto FIELD_READERS = makeCodecTable<ImportField>();
+} // namespace
+
+void CSVBImporter::readTable(ImporterEntry& entry, std::string_view csv)
+{
+    PROFILE_SCOPE("parse CSV");
+
+    const auto& codec = entry.codec;
+    const auto rowSize = codec.size();
+
+    data.reserve(data.size() + std::count(csv.begin(), csv.end(), '\n') * rowSize);
 
-            return hash;
+    CSVReader reader(csv);
+    reader.skipRow(); // header
+
+    std::string_view field;
+    bool rowEnd       = true;
+    std::size_t colId = 0;
+    uint8_t* row      = nullptr;
+
+    while (reader.next(field, rowEnd))
+    {
+        if (colId == 0)
+        {
+            data.resize(data.size() + rowSize);
+            row = data.data() + data.size() - rowSize;
+            entry.table.entryCount++;
         }
-        case DataType::VSTRING_UTF8:
+
+        if (colId >= codec.fieldCount())
+            throw std::runtime_error(
+                std::format("Too many columns in row {} of {}.csv", entry.table.entryCount, entry.name));
+
+        auto& fieldCodec = codec[colId++];
+        try
+        {
+            FIELD_READERS[static_cast<uint32_t>(fieldCodec.type)](field, row + fieldCodec.offset, strings);
+        }
+        catch (std::exception& e)
         {
-            auto offset = strings.add(value);
-            return *reinterpret_cast<uint32_t*>(&offset);
+            throw std::runtime_error(
+                std::format("{}.csv row {} column {}: {}", entry.name, entry.table.entryCount, colId, e.what()));
         }
+
+        if (rowEnd) colId = 0;
     }
+}
+
+void CSVBImporter::readColumnar(ImporterEntry& entry, const ColumnarTable& columns)
+{
+    PROFILE_SCOPE("read columnar");
+
+    const auto& codec  = entry.codec;
+    const auto rowSize = codec.size();
+
+    if (columns.columnCount() != codec.fieldCount())
+        throw std::runtime_error(std::format(
+            "{}.col has {} columns, the structure {}.", entry.name, columns.columnCount(), codec.fieldCount()));
 
-    return 0;
+    for (uint32_t i = 0; i < codec.fieldCount(); i++)
+        if (columns.column(i).type != codec[i].type)
+            throw std::runtime_error(std::format("{}.col column {} is a {}, the structure expects a {}.",
+                                                 entry.name,
+                                                 columns.columnName(i),
+                                                 getTypeKey(columns.column(i).type),
+                                                 getTypeKey(codec[i].type)));
+
+    // filled in on first use, adding strings in row order keeps the offsets parsing the CSV would give
+    constexpr uint32_t UNRESOLVED = 0xFFFFFFFF;
+    std::vector<uint32_t> offsets(columns.stringCount(), UNRESOLVED);
+
+    const auto begin = data.size();
+    data.resize(begin + static_cast<std::size_t>(columns.rowCount()) * rowSize);
+    entry.table.entryCount += columns.rowCount();
+
+    for (uint32_t i = 0; i < columns.rowCount(); i++)
+    {
+        auto* row = data.data() + begin + static_cast<std::size_t>(i) * rowSize;
+        for (uint32_t j = 0; j < codec.fieldCount(); j++)
+        {
+            auto& field = codec[j];
+            std::memcpy(row + field.offset, columns.value(j, i), field.size);
+            if (!isStringRefType(field.type)) continue;
+
+            uint32_t index;
+            std::memcpy(&index, row + field.offset, sizeof(index));
+            if (index >= offsets.size())
+                throw std::runtime_error(std::format("{}.col row {} column {}: invalid string index {}",
+                                                     entry.name,
+                                                     i + 1,
+                                                     j + 1,
+                                                     index));
+
+            if (offsets[index] == UNRESOLVED) offsets[index] = strings.add(columns.string(index));
+            std::memcpy(row + field.offset, &offsets[index], sizeof(uint32_t));
+        }
+    }
 }
 
-void CSVBImporter::write(std::filesystem::path outputPath)
+void CSVBImporter::readTableData(ImporterEntry& entry, std::span<const char> data)
 {
-    if (!std::filesystem::exists(outputPath))
+    if (ColumnarTable::isColumnar(data))
+        readColumnar(entry, ColumnarTable(data));
+    else
+        readTable(entry, { data.data(), data.size() });
+
+    PROFILE_COUNT(std::format("bytes imported: {}", entry.name), data.size());
+    PROFILE_COUNT(std::format("rows imported: {}", entry.name), entry.table.entryCount);
+}
+
+std::filesystem::path CSVBImporter::getTablePath(const std::filesystem::path& folder, const std::string& name)
+{
+    auto csvPath = (folder / name).concat(".csv");
+    if (std::filesystem::exists(csvPath)) return csvPath;
+
+    auto columnarPath = (folder / name).concat(ColumnarTable::EXTENSION);
+    if (std::filesystem::exists(columnarPath)) return columnarPath;
+
+    return csvPath;
+}
+
+void CSVBImporter::readTableIncremental(ImporterEntry& entry, const std::filesystem::path& path)
+{
+    auto stamp   = FileStamp::of(path);
+    auto* cached = previous->findTable(entry.name);
+    if (cached && cached->data.size() != static_cast<uint64_t>(cached->entryCount) * entry.codec.size())
+        cached = nullptr;
+
+    if (cached && cached->csv.sameFile(stamp))
     {
-        if (outputPath.has_parent_path()) std::filesystem::create_directories(outputPath.parent_path());
+        restoreTable(entry, *cached);
+        snapshots.push_back(*cached);
+        return;
     }
-    else if (!std::filesystem::is_regular_file(outputPath))
-        throw std::invalid_argument("Error: target path is not a file.");
 
-    const std::size_t headerSize = sizeof(CSVBHeader) + sizeof(CSVBTable) * entries.size();
+    MappedFile file;
+    bool exists = std::filesystem::exists(path);
+    if (exists) file = MappedFile(path);
+    stamp.hash = makeHash64({ file.data().data(), file.size() });
 
-    BinaryWriteBuffer dataBuff;
-    BinaryWriteBuffer structBuff;
-    BinaryWriteBuffer raw;
+    // touched, but not changed
+    if (cached && cached->csv.hash == stamp.hash)
+    {
+        restoreTable(entry, *cached);
+        snapshots.push_back(*cached);
+        snapshots.back().csv = stamp;
+        return;
+    }
 
-    std::ofstream out(outputPath, std::ios::out | std::ios::binary);
+    if (exists) readTableData(entry, file.data());
+    snapshots.push_back(captureTable(entry));
+    snapshots.back().csv = stamp;
+}
+
+void CSVBImporter::restoreTable(ImporterEntry& entry, const TableSnapshot& snapshot)
+{
+    PROFILE_SCOPE("restore table");
 
-    header.magic        = 'BVSC';
-    header.magicVersion = '3.4v';
-    header.tableCount   = static_cast<uint32_t>(entries.size());
+    // adding the strings in order of first use gives them the same offsets parsing the CSV would
+    std::vector<uint32_t> offsets;
+    offsets.reserve(snapshot.strings.size());
+    for (auto& string : snapshot.strings)
+        offsets.push_back(strings.add(string));
 
-    // write data section
-    for (auto& entry : entries)
+    const auto rowSize     = entry.codec.size();
+    entry.table.entryCount = snapshot.entryCount;
+    data.insert(data.end(), snapshot.data.begin(), snapshot.data.end());
+
+    for (uint32_t i = 0; i < snapshot.entryCount; i++)
     {
-        entry.table.dataOffset = static_cast<uint32_t>(headerSize + dataBuff.size());
-        dataBuff.write(entry.data);
+        auto* row = data.data() + entry.dataBegin + i * rowSize;
+        for (auto& field : entry.codec)
+        {
+            if (!isStringRefType(field.type)) continue;
+
+            uint32_t index;
+            std::memcpy(&index, row + field.offset, sizeof(index));
+            if (index >= offsets.size()) throw std::runtime_error("Invalid string index in pack manifest.");
+            std::memcpy(row + field.offset, &offsets[index], sizeof(uint32_t));
+        }
     }
-    int32_t toPad = (0x10 - ((headerSize + dataBuff.size()) % 0x10)) % 0x10;
-    for (int32_t i = 0; i < toPad; i++)
-        dataBuff.write((uint8_t)0);
+}
 
-    header.structureOffset = static_cast<uint32_t>(headerSize + dataBuff.size());
+TableSnapshot CSVBImporter::captureTable(const ImporterEntry& entry) const
+{
+    TableSnapshot snapshot;
+    snapshot.name       = entry.name;
+    snapshot.entryCount = entry.table.entryCount;
+    snapshot.data.assign(data.begin() + entry.dataBegin, data.end());
 
-    // write structure section
-    for (auto& entry : entries)
+    const auto rowSize = entry.codec.size();
+    std::unordered_map<uint32_t, uint32_t> indices;
+
+    for (uint32_t i = 0; i < snapshot.entryCount; i++)
+    {
+        auto* row = snapshot.data.data() + i * rowSize;
+        for (auto& field : entry.codec)
+        {
+            if (!isStringRefType(field.type)) continue;
+
+            uint32_t offset;
+            std::memcpy(&offset, row + field.offset, sizeof(offset));
+
+            auto [itr, inserted] = indices.try_emplace(offset, static_cast<uint32_t>(snapshot.strings.size()));
+            if (inserted) snapshot.strings.emplace_back(strings.at(offset));
+            std::memcpy(row + field.offset, &itr->second, sizeof(uint32_t));
+        }
+    }
+
+    return snapshot;
+}
+
+void CSVBImporter::finish()
+{
+    if (finished) return;
+    finished = true;
+
+    PROFILE_SCOPE("assemble CSVB");
+
+    // merged strings only get their final offsets now
+    strings.layout();
+    if (strings.mergesSuffixes())
     {
-        entry.table.structureOffset = static_cast<uint32_t>(structBuff.size());
-        structBuff.write(entry.datatypes);
+        for (auto& entry : entries)
+        {
+            for (uint32_t i = 0; i < entry.table.entryCount; i++)
+            {
+                auto* row = data.data() + entry.dataBegin + i * entry.codec.size();
+                for (auto& field : entry.codec)
+                {
+                    if (!isStringRefType(field.type)) continue;
+
+                    uint32_t offset;
+                    std::memcpy(&offset, row + field.offset, sizeof(offset));
+                    offset = strings.resolve(offset);
+                    std::memcpy(row + field.offset, &offset, sizeof(offset));
+                }
+            }
+        }
     }
-    structBuff.padTo(0x10);
-    header.stringOffset = static_cast<uint32_t>(headerSize + dataBuff.size() + structBuff.size());
 
-    // write string section
-    std::vector<uint8_t> stringRaw;
-    stringRaw.resize(strings.totalSize());
+    // every section offset is known up front, so the sections can be streamed to the file as they are
+    const std::size_t headerSize = sizeof(CSVBHeader) + sizeof(CSVBTable) * entries.size();
+    const std::size_t dataSize   = data.size() + (0x10 - ((headerSize + data.size()) % 0x10)) % 0x10;
 
-    for (auto& entry : strings)
-        memcpy(stringRaw.data() + entry.second, entry.first.data(), entry.first.size());
+    std::size_t structSize = 0;
+    for (auto& entry : entries)
+    {
+        entry.table.dataOffset      = static_cast<uint32_t>(headerSize + entry.dataBegin);
+        entry.table.structureOffset = static_cast<uint32_t>(structSize);
+        structSize += entry.datatypes.size() * sizeof(DataType);
+    }
+    const std::size_t structPadding = (0x10 - (structSize % 0x10)) % 0x10;
+    structSize += structPadding;
+
+    const std::size_t stringSize = strings.totalSize();
+    const std::size_t totalSize  = headerSize + dataSize + structSize + stringSize;
+
+    header.magic           = 'BVSC';
+    header.magicVersion    = '3.4v';
+    header.tableCount      = static_cast<uint32_t>(entries.size());
+    header.structureOffset = static_cast<uint32_t>(headerSize + dataSize);
+    header.stringOffset    = static_cast<uint32_t>(headerSize + dataSize + structSize);
+    header.unkOffset1      = static_cast<uint32_t>(totalSize);
+    header.unkOffset2      = static_cast<uint32_t>(totalSize);
+    header.unkOffset3      = 0u;
+
+    // variable data sections are appended as extracted, only their offsets move
+    if (variableData.size() != 0)
+    {
+        VariableDataHeader varHeader;
+        if (variableData.size() < sizeof(varHeader)) throw std::runtime_error("Variable data file is truncated.");
+        std::memcpy(&varHeader, variableData.data(), sizeof(varHeader));
+        variable = variableData.subspan(sizeof(varHeader));
+
+        if (varHeader.magic == VariableDataHeader::MAGIC && varHeader.version < VariableDataHeader::VERSION)
+            throw std::runtime_error("Variable data file was written by an older version, extract the file again.");
+        if (varHeader.magic != VariableDataHeader::MAGIC || varHeader.version != VariableDataHeader::VERSION)
+            throw std::runtime_error("Variable data file has an unknown format.");
+        // offsets inside the sections can't be relocated until their layout is known
+        if (totalSize != varHeader.vFormOffset || dataSize != varHeader.dataSize || stringSize != varHeader.stringSize)
+            throw std::runtime_error(std::format("The data section is {} bytes and the string section {} bytes, but "
+                                                 "the variable data needs them to stay at {} and {} bytes. Files "
+                                                 "with variable data only support edits that keep their size.",
+                                                 dataSize,
+                                                 stringSize,
+                                                 varHeader.dataSize,
+                                                 varHeader.stringSize));
+        if (varHeader.vDataOffset > variable.size())
+            throw std::runtime_error("Variable data file has an invalid vData offset.");
+        if (totalSize + variable.size() > UINT32_MAX) throw std::runtime_error("Packed file exceeds 4 GiB.");
+
+        header.unkOffset2 = static_cast<uint32_t>(totalSize + varHeader.vDataOffset);
+        if (varHeader.flags & VariableDataHeader::ABSOLUTE_MAPPING)
+            header.unkOffset3 = varHeader.mappingOffset;
+        else if (varHeader.mappingOffset != VariableDataHeader::NO_MAPPING)
+            header.unkOffset3 = static_cast<uint32_t>(totalSize + varHeader.mappingOffset);
+    }
 
-    // finalize header
-    header.unkOffset1 = static_cast<uint32_t>(headerSize + dataBuff.size() + structBuff.size() + stringRaw.size());
-    header.unkOffset2 = static_cast<uint32_t>(headerSize + dataBuff.size() + structBuff.size() + stringRaw.size());
-    header.unkOffset3 = 0u;
+    // the small sections are assembled in one buffer, the data section is written straight from the rows
+    head.resize(headerSize);
+    std::memcpy(head.data(), &header, sizeof(header));
+    for (std::size_t i = 0; i < entries.size(); i++)
+        std::memcpy(head.data() + sizeof(header) + i * sizeof(CSVBTable), &entries[i].table, sizeof(CSVBTable));
 
-    // write everything to file
-    raw.write(header);
+    tail.resize(dataSize - data.size() + structSize + stringSize);
+    char* structure = tail.data() + (dataSize - data.size());
     for (auto& entry : entries)
-        raw.write(entry.table);
-    raw.write(dataBuff);
-    raw.write(structBuff);
-    raw.write(stringRaw);
+        std::memcpy(structure + entry.table.structureOffset,
+                    entry.datatypes.data(),
+                    entry.datatypes.size() * sizeof(DataType));
+
+    strings.copyTo(structure + structSize);
+}
 
-    out.write(reinterpret_cast<char*>(raw.data.data()), raw.data.size());
+std::size_t CSVBImporter::packedSize()
+{
+    finish();
+    return head.size() + data.size() + tail.size() + variable.size();
+}
+
+void CSVBImporter::write(std::filesystem::path outputPath)
+{
+    if (!std::filesystem::exists(outputPath))
+    {
+        if (outputPath.has_parent_path()) std::filesystem::create_directories(outputPath.parent_path());
+    }
+    else if (!std::filesystem::is_regular_file(outputPath))
+        throw std::invalid_argument("Error: target path is not a file.");
+
+    finish();
+
+    PROFILE_SCOPE("write CSVB");
+    std::ofstream out(outputPath, std::ios::out | std::ios::binary);
+    out.write(head.data(), head.size());
+    out.write(reinterpret_cast<const char*>(data.data()), data.size());
+    out.write(tail.data(), tail.size());
+    out.write(variable.data(), variable.size());
+    if (!out) throw std::runtime_error("Error: failed to write " + outputPath.string());
+}
+
+std::size_t CSVBImporter::writeTo(std::span<std::byte> buffer)
+{
+    const auto size = packedSize();
+    if (buffer.size() < size)
+        throw std::invalid_argument(
+            std::format("Buffer of {} bytes is too small for the packed file of {} bytes.", buffer.size(), size));
+
+    auto* dest = reinterpret_cast<char*>(buffer.data());
+    dest       = std::copy(head.begin(), head.end(), dest);
+    dest       = std::copy(data.begin(), data.end(), dest);
+    dest       = std::copy(tail.begin(), tail.end(), dest);
+    std::copy(variable.begin(), variable.end(), dest);
+
+    return size;
 }
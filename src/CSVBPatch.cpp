@@ -0,0 +1,619 @@
+#include "CSVBPatch.hpp"
+#include "ColumnarTable.hpp"
+#include "MappedFile.hpp"
+#include "Profiler.hpp"
+#include "StructureRegistry.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace
+{
+    constexpr uint32_t REPLACES_VARIABLE_DATA = 1;
+    constexpr uint32_t NO_MATCH               = std::numeric_limits<uint32_t>::max();
+
+    class PatchWriter
+    {
+        std::vector<char> buffer;
+
+    public:
+        template<typename T>
+        void put(const T& value)
+        {
+            auto* ptr = reinterpret_cast<const char*>(&value);
+            buffer.insert(buffer.end(), ptr, ptr + sizeof(T));
+        }
+
+        void put(std::string_view value)
+        {
+            put(static_cast<uint32_t>(value.size()));
+            buffer.insert(buffer.end(), value.begin(), value.end());
+        }
+
+        void put(const std::vector<uint32_t>& values)
+        {
+            put(static_cast<uint32_t>(values.size()));
+            for (auto value : values)
+                put(value);
+        }
+
+        std::vector<char>& data() { return buffer; }
+    };
+
+    class PatchReader
+    {
+        std::span<const char> data;
+        std::size_t pos = 0;
+
+    public:
+        PatchReader(std::span<const char> data)
+            : data(data)
+        {
+        }
+
+        std::string_view bytes(uint64_t count)
+        {
+            if (count > data.size() - pos) throw std::runtime_error("Truncated patch.");
+            std::string_view value(data.data() + pos, count);
+            pos += count;
+            return value;
+        }
+
+        template<typename T>
+        T get()
+        {
+            T value;
+            std::memcpy(&value, bytes(sizeof(T)).data(), sizeof(T));
+            return value;
+        }
+
+        std::string_view string() { return bytes(get<uint32_t>()); }
+
+        // number of elements that take at least minSize bytes each, checked before anything is allocated for them
+        uint32_t count(std::size_t minSize)
+        {
+            auto value = get<uint32_t>();
+            if (value > (data.size() - pos) / minSize) throw std::runtime_error("Truncated patch.");
+            return value;
+        }
+
+        std::vector<uint32_t> ids()
+        {
+            std::vector<uint32_t> values(count(sizeof(uint32_t)));
+            for (auto& value : values)
+                value = get<uint32_t>();
+            return values;
+        }
+
+        bool atEnd() const { return pos == data.size(); }
+    };
+
+    CSVBView makeView(std::span<const std::byte> data, std::string_view role)
+    {
+        CSVBView view(asChars(data));
+        if (!view.isValid()) throw std::runtime_error(std::format("The {} file is not a CSVB file.", role));
+        return view;
+    }
+
+    void checkLayout(const CSVBView& base, const CSVBView& target)
+    {
+        if (base.tableCount() != target.tableCount())
+            throw std::runtime_error(
+                std::format("The files have {} and {} tables.", base.tableCount(), target.tableCount()));
+
+        for (std::size_t i = 0; i < base.tableCount(); i++)
+        {
+            auto lhs = base.table(i);
+            auto rhs = target.table(i);
+            if (lhs.name() != rhs.name() || lhs.flag() != rhs.flag() || !std::ranges::equal(lhs.types(), rhs.types()))
+                throw std::runtime_error(
+                    std::format("Table {} differs in name or fields, compare the extracted CSVs instead.", i));
+        }
+    }
+
+    // the variable data sections as extracted to variable.bin, empty if the file has none
+    std::vector<char> getVariableFile(const CSVBView& view)
+    {
+        if (!view.hasVariableData()) return {};
+
+        auto header   = view.variableDataHeader();
+        auto variable = view.variableData();
+
+        std::vector<char> file(sizeof(header) + variable.size());
+        std::memcpy(file.data(), &header, sizeof(header));
+        std::memcpy(file.data() + sizeof(header), variable.data(), variable.size());
+        return file;
+    }
+
+    int32_t findKeyField(const RowCodec& codec)
+    {
+        for (std::size_t i = 0; i < codec.fieldCount(); i++)
+            if (isHashType(codec[i].type)) return static_cast<int32_t>(i);
+        return CSVBPatch::NO_KEY;
+    }
+
+    // row index by key, nothing if a key is used twice
+    std::optional<std::unordered_map<uint32_t, uint32_t>> indexKeys(const CSVBView::Table& table, const FieldCodec& key)
+    {
+        std::unordered_map<uint32_t, uint32_t> keys;
+        keys.reserve(table.entryCount());
+
+        for (uint32_t i = 0; i < table.entryCount(); i++)
+            if (!keys.try_emplace(table.row(i).get<uint32_t>(key.offset), i).second) return std::nullopt;
+        return keys;
+    }
+
+    std::string getValue(const CSVBView& view, CSVBView::Row row, const FieldCodec& field)
+    {
+        if (isStringRefType(field.type)) return std::string(view.string(row.get<uint32_t>(field.offset)));
+        return std::string(row.data() + field.offset, field.size);
+    }
+
+    bool sameValue(const CSVBView& base,
+                   CSVBView::Row lhs,
+                   const CSVBView& target,
+                   CSVBView::Row rhs,
+                   const FieldCodec& field)
+    {
+        // string offsets differ between files even for the same text
+        if (isStringRefType(field.type))
+            return base.string(lhs.get<uint32_t>(field.offset)) == target.string(rhs.get<uint32_t>(field.offset));
+        return std::memcmp(lhs.data() + field.offset, rhs.data() + field.offset, field.size) == 0;
+    }
+
+    CSVBPatch::Table diffTable(const CSVBView& base, const CSVBView& target, std::size_t index)
+    {
+        auto lhs   = base.table(index);
+        auto rhs   = target.table(index);
+        auto types = lhs.types();
+        RowCodec codec(types);
+
+        CSVBPatch::Table patch;
+        patch.index    = static_cast<uint32_t>(index);
+        patch.name     = lhs.name();
+        patch.keyField = findKeyField(codec);
+        patch.types.assign(types.begin(), types.end());
+
+        std::optional<std::unordered_map<uint32_t, uint32_t>> baseKeys;
+        std::optional<std::unordered_map<uint32_t, uint32_t>> targetKeys;
+        if (patch.keyField != CSVBPatch::NO_KEY)
+        {
+            baseKeys   = indexKeys(lhs, codec[patch.keyField]);
+            targetKeys = indexKeys(rhs, codec[patch.keyField]);
+            if (!baseKeys || !targetKeys) patch.keyField = CSVBPatch::NO_KEY;
+        }
+
+        auto getId = [&](uint32_t row)
+        {
+            if (patch.keyField == CSVBPatch::NO_KEY) return row;
+            return lhs.row(row).get<uint32_t>(codec[patch.keyField].offset);
+        };
+
+        // the base row of every target row
+        std::vector<uint32_t> matches(rhs.entryCount(), NO_MATCH);
+        if (patch.keyField == CSVBPatch::NO_KEY)
+        {
+            for (uint32_t i = 0; i < rhs.entryCount() && i < lhs.entryCount(); i++)
+                matches[i] = i;
+            for (uint32_t i = rhs.entryCount(); i < lhs.entryCount(); i++)
+                patch.removed.push_back(i);
+        }
+        else
+        {
+            auto& key = codec[patch.keyField];
+            for (uint32_t i = 0; i < rhs.entryCount(); i++)
+            {
+                auto itr = baseKeys->find(rhs.row(i).get<uint32_t>(key.offset));
+                if (itr != baseKeys->end()) matches[i] = itr->second;
+            }
+            for (uint32_t i = 0; i < lhs.entryCount(); i++)
+            {
+                auto id = lhs.row(i).get<uint32_t>(key.offset);
+                if (!targetKeys->contains(id)) patch.removed.push_back(id);
+            }
+        }
+
+        std::vector<uint32_t> kept;
+        bool ordered  = true;
+        uint32_t last = 0;
+        for (uint32_t i = 0; i < rhs.entryCount(); i++)
+        {
+            auto targetRow = rhs.row(i);
+            if (matches[i] == NO_MATCH)
+            {
+                auto& row    = patch.added.emplace_back();
+                row.position = i;
+                for (auto& field : codec)
+                    row.values.push_back(getValue(target, targetRow, field));
+                continue;
+            }
+
+            ordered  = ordered && (kept.empty() || matches[i] > last);
+            last     = matches[i];
+            auto id  = getId(matches[i]);
+            auto row = lhs.row(matches[i]);
+            kept.push_back(id);
+
+            CSVBPatch::ChangedRow changed{ id, {} };
+            for (uint32_t j = 0; j < codec.fieldCount(); j++)
+                if (!sameValue(base, row, target, targetRow, codec[j]))
+                    changed.fields.push_back({ j, getValue(target, targetRow, codec[j]) });
+            if (!changed.fields.empty()) patch.changed.push_back(std::move(changed));
+        }
+
+        if (!ordered) patch.order = std::move(kept);
+        return patch;
+    }
+
+    // Rows of a table while a patch is applied. String fields hold indices into strings instead of offsets, which
+    // point into the base file or the patch.
+    class PatchedTable
+    {
+        const RowCodec& codec;
+        std::vector<char> storage; // every row ever created, back to back
+        std::vector<std::string_view> strings;
+
+    private:
+        char* row(uint32_t index) { return storage.data() + static_cast<std::size_t>(index) * codec.size(); }
+
+    public:
+        std::vector<uint32_t> rows; // storage index of every row in order
+
+    public:
+        PatchedTable(const RowCodec& codec)
+            : codec(codec)
+        {
+        }
+
+        uint32_t addRow()
+        {
+            auto index = static_cast<uint32_t>(storage.size() / codec.size());
+            storage.resize(storage.size() + codec.size());
+            return index;
+        }
+
+        void copyRow(uint32_t index, const CSVBView& view, CSVBView::Row source)
+        {
+            std::memcpy(row(index), source.data(), codec.size());
+            for (auto& field : codec)
+            {
+                if (isStringRefType(field.type))
+                    setString(index, field, view.string(source.get<uint32_t>(field.offset)));
+            }
+        }
+
+        void setString(uint32_t index, const FieldCodec& field, std::string_view value)
+        {
+            auto string = static_cast<uint32_t>(strings.size());
+            strings.push_back(value);
+            std::memcpy(row(index) + field.offset, &string, sizeof(string));
+        }
+
+        void setValue(uint32_t index, uint32_t field, std::string_view value)
+        {
+            if (field >= codec.fieldCount()) throw std::runtime_error(std::format("Patch refers to field {}.", field));
+
+            auto& info = codec[field];
+            if (isStringRefType(info.type))
+                setString(index, info, value);
+            else if (value.size() != info.size)
+                throw std::runtime_error(std::format("Patch has a {} byte value for field {}.", value.size(), field));
+            else
+                std::memcpy(row(index) + info.offset, value.data(), value.size());
+        }
+
+        uint32_t getKey(uint32_t index, uint32_t field)
+        {
+            uint32_t key;
+            std::memcpy(&key, row(index) + codec[field].offset, sizeof(key));
+            return key;
+        }
+
+        std::vector<char> encode(std::span<const std::string> names) const
+        {
+            std::vector<char> data(rows.size() * codec.size());
+            for (std::size_t i = 0; i < rows.size(); i++)
+                std::memcpy(data.data() + i * codec.size(),
+                            storage.data() + static_cast<std::size_t>(rows[i]) * codec.size(),
+                            codec.size());
+
+            return ColumnarTable::encode(data.data(),
+                                         static_cast<uint32_t>(rows.size()),
+                                         codec.size(),
+                                         codec,
+                                         names,
+                                         [&](uint32_t index) { return strings[index]; });
+        }
+    };
+
+    std::vector<char> applyTable(const CSVBView& view,
+                                 const CSVBPatch::Table& patch,
+                                 const TableStructure& structure)
+    {
+        auto source = view.table(patch.index);
+        auto& codec = structure.codec;
+
+        if (patch.name != source.name() || !std::ranges::equal(patch.types, source.types()))
+            throw std::runtime_error(std::format("Table {} differs from the one the patch was made for.", patch.name));
+        if (patch.keyField != CSVBPatch::NO_KEY && static_cast<std::size_t>(patch.keyField) >= codec.fieldCount())
+            throw std::runtime_error(std::format("Table {} has no key field {}.", patch.name, patch.keyField));
+
+        PatchedTable table(codec);
+        std::unordered_map<uint32_t, uint32_t> ids; // storage index of each base row by id
+        for (uint32_t i = 0; i < source.entryCount(); i++)
+        {
+            auto index = table.addRow();
+            table.copyRow(index, view, source.row(i));
+
+            auto id = patch.keyField == CSVBPatch::NO_KEY ? i : table.getKey(index, patch.keyField);
+            ids.emplace(id, index);
+        }
+
+        auto find = [&](uint32_t id)
+        {
+            auto itr = ids.find(id);
+            if (itr == ids.end())
+                throw std::runtime_error(std::format("Table {} has no row {:08x} to patch.", patch.name, id));
+            return itr->second;
+        };
+
+        std::unordered_set<uint32_t> removed;
+        for (auto id : patch.removed)
+            removed.insert(find(id));
+        for (auto& row : patch.changed)
+        {
+            auto index = find(row.id);
+            for (auto& field : row.fields)
+                table.setValue(index, field.field, field.value);
+        }
+
+        std::vector<uint32_t> kept;
+        if (patch.order.empty())
+        {
+            for (uint32_t i = 0; i < source.entryCount(); i++)
+                if (!removed.contains(i)) kept.push_back(i);
+        }
+        else
+        {
+            for (auto id : patch.order)
+                kept.push_back(find(id));
+            if (kept.size() + removed.size() != source.entryCount())
+                throw std::runtime_error(std::format("Order of table {} doesn't cover its rows.", patch.name));
+        }
+
+        // inserting in ascending position leaves every row at its target position
+        auto next = kept.begin();
+        for (auto& added : patch.added)
+        {
+            if (added.values.size() != codec.fieldCount())
+                throw std::runtime_error(std::format("Added row of table {} has the wrong field count.", patch.name));
+            if (added.position < table.rows.size() || added.position > table.rows.size() + (kept.end() - next))
+                throw std::runtime_error(std::format("Added row of table {} is out of order.", patch.name));
+
+            while (table.rows.size() < added.position)
+                table.rows.push_back(*next++);
+
+            auto index = table.addRow();
+            for (uint32_t i = 0; i < codec.fieldCount(); i++)
+                table.setValue(index, i, added.values[i]);
+            table.rows.push_back(index);
+        }
+        table.rows.insert(table.rows.end(), next, kept.end());
+
+        return table.encode(structure.columns);
+    }
+
+    // structure of the tables of a file, which is all packing needs
+    Structure getStructure(const CSVBView& view)
+    {
+        Structure structure;
+        for (std::size_t i = 0; i < view.tableCount(); i++)
+        {
+            auto source = view.table(i);
+            auto types  = source.types();
+
+            auto& table = structure.tables.emplace_back();
+            table.name  = source.name();
+            table.flag  = source.flag();
+            table.types.assign(types.begin(), types.end());
+            table.codec = RowCodec(types);
+            for (std::size_t j = 0; j < types.size(); j++)
+                table.columns.push_back(getTypeName(types[j], static_cast<int32_t>(j)));
+        }
+        return structure;
+    }
+} // namespace
+
+CSVBPatch CSVBPatch::diff(std::span<const std::byte> base, std::span<const std::byte> target)
+{
+    PROFILE_SCOPE("diff CSVB");
+
+    auto baseView   = makeView(base, "base");
+    auto targetView = makeView(target, "target");
+    checkLayout(baseView, targetView);
+
+    CSVBPatch patch;
+    patch.baseFingerprint   = makeHash64({ reinterpret_cast<const char*>(base.data()), base.size() });
+    patch.targetFingerprint = makeHash64({ reinterpret_cast<const char*>(target.data()), target.size() });
+
+    for (std::size_t i = 0; i < baseView.tableCount(); i++)
+    {
+        auto table = diffTable(baseView, targetView, i);
+        if (!table.removed.empty() || !table.changed.empty() || !table.added.empty() || !table.order.empty())
+            patch.tables.push_back(std::move(table));
+    }
+
+    auto variableData = getVariableFile(targetView);
+    if (variableData != getVariableFile(baseView))
+    {
+        patch.replacesVariableData = true;
+        patch.variableData         = std::move(variableData);
+    }
+
+    return patch;
+}
+
+std::vector<std::byte> CSVBPatch::apply(std::span<const std::byte> base) const
+{
+    PROFILE_SCOPE("apply patch");
+
+    if (makeHash64({ reinterpret_cast<const char*>(base.data()), base.size() }) != baseFingerprint)
+        throw std::runtime_error("The patch was made for a different version of the file.");
+
+    auto view      = makeView(base, "base");
+    auto structure = getStructure(view);
+
+    // unchanged tables are carried over as columnar tables as well, so nothing goes through CSV
+    std::vector<std::vector<char>> encoded(view.tableCount());
+    for (auto& table : tables)
+    {
+        if (table.index >= view.tableCount())
+            throw std::runtime_error(std::format("The file has no table {}.", table.index));
+        encoded[table.index] = applyTable(view, table, structure.tables[table.index]);
+    }
+
+    CSVBImporter::TableSources sources;
+    for (std::size_t i = 0; i < view.tableCount(); i++)
+    {
+        auto& table = structure.tables[i];
+        if (encoded[i].empty()) encoded[i] = ColumnarTable::encode(view, i, table.codec, table.columns);
+        sources.emplace(table.name, std::as_bytes(std::span(encoded[i])));
+    }
+
+    auto variable = replacesVariableData ? variableData : getVariableFile(view);
+    CSVBImporter importer(structure, sources, std::as_bytes(std::span(variable)));
+
+    std::vector<std::byte> result(importer.packedSize());
+    importer.writeTo(result);
+    return result;
+}
+
+std::vector<char> CSVBPatch::encode() const
+{
+    PatchWriter writer;
+    writer.put(MAGIC);
+    writer.put(VERSION);
+    writer.put(replacesVariableData ? REPLACES_VARIABLE_DATA : 0u);
+    writer.put(static_cast<uint32_t>(tables.size()));
+    writer.put(baseFingerprint);
+    writer.put(targetFingerprint);
+
+    for (auto& table : tables)
+    {
+        writer.put(table.index);
+        writer.put(std::string_view(table.name));
+        writer.put(table.keyField);
+        writer.put(static_cast<uint32_t>(table.types.size()));
+        for (auto type : table.types)
+            writer.put(type);
+
+        writer.put(table.removed);
+        writer.put(table.order);
+
+        writer.put(static_cast<uint32_t>(table.changed.size()));
+        for (auto& row : table.changed)
+        {
+            writer.put(row.id);
+            writer.put(static_cast<uint32_t>(row.fields.size()));
+            for (auto& field : row.fields)
+            {
+                writer.put(field.field);
+                writer.put(std::string_view(field.value));
+            }
+        }
+
+        writer.put(static_cast<uint32_t>(table.added.size()));
+        for (auto& row : table.added)
+        {
+            writer.put(row.position);
+            for (auto& value : row.values)
+                writer.put(std::string_view(value));
+        }
+    }
+
+    if (replacesVariableData) writer.put(std::string_view(variableData.data(), variableData.size()));
+
+    return std::move(writer.data());
+}
+
+CSVBPatch CSVBPatch::decode(std::span<const char> data)
+{
+    PatchReader reader(data);
+    if (reader.get<uint32_t>() != MAGIC) throw std::runtime_error("Not a CSVB patch.");
+    if (reader.get<uint32_t>() != VERSION) throw std::runtime_error("Unsupported CSVB patch version.");
+
+    CSVBPatch patch;
+    patch.replacesVariableData = (reader.get<uint32_t>() & REPLACES_VARIABLE_DATA) != 0;
+    // index, name, key field and the counts of types, removed, order, changed and added rows
+    patch.tables.resize(reader.count(8 * sizeof(uint32_t)));
+    patch.baseFingerprint   = reader.get<uint64_t>();
+    patch.targetFingerprint = reader.get<uint64_t>();
+
+    for (auto& table : patch.tables)
+    {
+        table.index    = reader.get<uint32_t>();
+        table.name     = reader.string();
+        table.keyField = reader.get<int32_t>();
+        table.types.resize(reader.count(sizeof(DataType)));
+        for (auto& type : table.types)
+            type = reader.get<DataType>();
+
+        table.removed = reader.ids();
+        table.order   = reader.ids();
+
+        table.changed.resize(reader.count(2 * sizeof(uint32_t)));
+        for (auto& row : table.changed)
+        {
+            row.id = reader.get<uint32_t>();
+            row.fields.resize(reader.count(2 * sizeof(uint32_t)));
+            for (auto& field : row.fields)
+            {
+                field.field = reader.get<uint32_t>();
+                field.value = reader.string();
+            }
+        }
+
+        table.added.resize(reader.count((1 + table.types.size()) * sizeof(uint32_t)));
+        for (auto& row : table.added)
+        {
+            row.position = reader.get<uint32_t>();
+            row.values.resize(table.types.size());
+            for (auto& value : row.values)
+                value = reader.string();
+        }
+    }
+
+    if (patch.replacesVariableData)
+    {
+        auto variable = reader.string();
+        patch.variableData.assign(variable.begin(), variable.end());
+    }
+    if (!reader.atEnd()) throw std::runtime_error("Trailing data after CSVB patch.");
+
+    return patch;
+}
+
+CSVBPatch CSVBPatch::read(const std::filesystem::path& path)
+{
+    MappedFile file(path);
+    return decode(file.data());
+}
+
+void CSVBPatch::write(const std::filesystem::path& path) const
+{
+    auto data = encode();
+
+    if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path());
+    std::ofstream output(path, std::ios::out | std::ios::binary);
+    output.write(data.data(), data.size());
+    if (!output) throw std::runtime_error("Error: failed to write " + path.string());
+}
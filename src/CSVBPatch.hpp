@@ -0,0 +1,78 @@
+#pragma once
+
+#include "CSVB.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <vector>
+
+/*
+ * Row and field level differences between two versions of a CSVB file with the same tables.
+ * Rows are matched by the first hash field of their table, or by position if a table has none or its keys aren't
+ * unique. Only the fields that changed are stored, strings by their text. apply() turns the base file into the
+ * target without going through CSV.
+ *
+ * Rows are identified by an id, which is the key of the row, or its index in the base file when matching by position.
+ */
+class CSVBPatch
+{
+public:
+    struct FieldValue
+    {
+        uint32_t field;
+        std::string value; // the field's bytes, the text of string fields
+    };
+
+    struct ChangedRow
+    {
+        uint32_t id;
+        std::vector<FieldValue> fields;
+    };
+
+    struct AddedRow
+    {
+        uint32_t position;               // index in the target table
+        std::vector<std::string> values; // one per field
+    };
+
+    struct Table
+    {
+        uint32_t index;
+        std::string name;
+        int32_t keyField; // NO_KEY when matching by position
+        std::vector<DataType> types;
+        std::vector<uint32_t> removed;
+        std::vector<ChangedRow> changed;
+        std::vector<AddedRow> added;
+        std::vector<uint32_t> order; // ids of the kept rows in target order, empty if they kept their order
+    };
+
+    uint64_t baseFingerprint   = 0; // makeHash64 of the base file
+    uint64_t targetFingerprint = 0; // and of the target file
+    std::vector<Table> tables;      // only tables with changes
+    bool replacesVariableData = false;
+    std::vector<char> variableData; // the target's extracted variable data, see VariableDataHeader
+
+public:
+    // throws std::runtime_error if the files aren't CSVBs with the same tables and field types
+    static CSVBPatch diff(std::span<const std::byte> base, std::span<const std::byte> target);
+    // throws std::runtime_error if base isn't the file the patch was made for
+    std::vector<std::byte> apply(std::span<const std::byte> base) const;
+
+    bool empty() const { return tables.empty() && !replacesVariableData; }
+
+    std::vector<char> encode() const;
+    // throws std::runtime_error if the data isn't a valid patch
+    static CSVBPatch decode(std::span<const char> data);
+    static CSVBPatch read(const std::filesystem::path& path);
+    void write(const std::filesystem::path& path) const;
+
+    static constexpr uint32_t MAGIC   = 'TAPC'; // "CPAT" in the file
+    static constexpr uint32_t VERSION = 1;
+    static constexpr int32_t NO_KEY   = -1;
+
+    static constexpr const char* EXTENSION = ".patch";
+};
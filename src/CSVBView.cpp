@@ -0,0 +1,105 @@
+#include "CSVB.hpp"
+#include "Profiler.hpp"
+
+#include <format>
+#include <stdexcept>
+
+CSVBView::CSVBView(std::span<const char> data)
+    : data(data)
+{
+    PROFILE_SCOPE("validate CSVB");
+
+    if (data.size() < sizeof(CSVBHeader)) return;
+
+    std::memcpy(&header, data.data(), sizeof(CSVBHeader));
+    if (header.magic != 'BVSC' || header.magicVersion != '3.4v') return;
+
+    validate();
+    valid = true;
+}
+
+void CSVBView::validate()
+{
+    const uint64_t size = data.size();
+
+    if (sizeof(CSVBHeader) + static_cast<uint64_t>(header.tableCount) * sizeof(CSVBTable) > size)
+        throw std::runtime_error(std::format("CSVB table list exceeds file size of {} bytes.", size));
+    if (header.structureOffset > size || header.stringOffset > size)
+        throw std::runtime_error("CSVB section offsets exceed file size.");
+
+    tables = { reinterpret_cast<const CSVBTable*>(data.data() + sizeof(CSVBHeader)), header.tableCount };
+
+    // the string section is followed by the variable data sections, if there are any
+    stringEnd = header.unkOffset1 >= header.stringOffset && header.unkOffset1 <= size ? header.unkOffset1 : size;
+
+    for (auto& table : tables)
+    {
+        const uint64_t structureStart = static_cast<uint64_t>(header.structureOffset) + table.structureOffset;
+        if (structureStart + static_cast<uint64_t>(table.fieldCount) * sizeof(DataType) > size)
+            throw std::runtime_error(std::format("Structure of table {} exceeds file size.", table.name_str()));
+
+        const uint64_t dataEnd = table.dataOffset + static_cast<uint64_t>(table.entrySize) * table.entryCount;
+        if (dataEnd > size)
+            throw std::runtime_error(std::format("Data of table {} exceeds file size.", table.name_str()));
+
+        uint64_t rowSize = 0;
+        for (auto type : Table(this, &table).types())
+            rowSize += getDataTypeSize(type);
+        if (rowSize > table.entrySize)
+            throw std::runtime_error(std::format("Fields of table {} exceed its entry size.", table.name_str()));
+    }
+}
+
+std::span<const DataType> CSVBView::Table::types() const
+{
+    auto ptr = view->data.data() + view->header.structureOffset + table->structureOffset;
+    return { reinterpret_cast<const DataType*>(ptr), table->fieldCount };
+}
+
+bool CSVBView::hasVariableData() const
+{
+    // files without variable data end with the string section and have no mapping
+    return header.unkOffset1 == stringEnd && (stringEnd < data.size() || header.unkOffset3 != 0);
+}
+
+VariableDataHeader CSVBView::variableDataHeader() const
+{
+    auto variable = variableData();
+
+    if (header.unkOffset2 < header.unkOffset1 || header.unkOffset2 - header.unkOffset1 > variable.size())
+        throw std::runtime_error("vData offset is outside of the variable data.");
+
+    const auto dataBegin = sizeof(CSVBHeader) + tableCount() * sizeof(CSVBTable);
+    if (header.structureOffset < dataBegin || header.unkOffset1 < header.stringOffset)
+        throw std::runtime_error("Sections are out of order.");
+
+    VariableDataHeader varHeader{ VariableDataHeader::MAGIC,
+                                  VariableDataHeader::VERSION,
+                                  0,
+                                  header.unkOffset2 - header.unkOffset1,
+                                  VariableDataHeader::NO_MAPPING,
+                                  header.unkOffset1,
+                                  static_cast<uint32_t>(header.structureOffset - dataBegin),
+                                  header.unkOffset1 - header.stringOffset };
+    if (header.unkOffset3 >= header.unkOffset1)
+        varHeader.mappingOffset = header.unkOffset3 - header.unkOffset1;
+    else if (header.unkOffset3 != 0)
+    {
+        varHeader.flags         = VariableDataHeader::ABSOLUTE_MAPPING;
+        varHeader.mappingOffset = header.unkOffset3;
+    }
+
+    return varHeader;
+}
+
+std::string_view CSVBView::string(uint32_t offset) const
+{
+    const uint64_t start = static_cast<uint64_t>(header.stringOffset) + offset;
+    if (start >= stringEnd) throw std::runtime_error(std::format("String offset {} exceeds string section.", offset));
+
+    auto begin = data.data() + start;
+    auto end   = static_cast<const char*>(std::memchr(begin, 0, stringEnd - start));
+    if (end == nullptr) throw std::runtime_error(std::format("String at offset {} is not terminated.", offset));
+
+    return { begin, static_cast<std::size_t>(end - begin) };
+}
@@ -0,0 +1,94 @@
+#include "CSVReader.hpp"
+
+#include <format>
+#include <stdexcept>
+
+CSVReader::CSVReader(std::string_view input)
+    : input(input)
+{
+    // files saved by some editors start with a UTF-8 BOM
+    if (input.starts_with("\xEF\xBB\xBF")) pos = 3;
+}
+
+void CSVReader::skipRowEnd()
+{
+    if (pos < input.size() && input[pos] == '\r') pos++;
+    if (pos < input.size() && input[pos] == '\n') pos++;
+}
+
+std::string_view CSVReader::readQuoted()
+{
+    scratch.clear();
+    pos++; // opening quote
+
+    while (true)
+    {
+        // line breaks inside quotes are part of the value, CR included
+        auto end = input.find('"', pos);
+        if (end == std::string_view::npos)
+            throw std::runtime_error(std::format("Unterminated quoted field in row {}.", row));
+
+        scratch.append(input.data() + pos, end - pos);
+        pos = end + 1;
+
+        if (pos < input.size() && input[pos] == '"')
+        {
+            scratch.push_back('"');
+            pos++;
+            continue;
+        }
+
+        break;
+    }
+
+    // tolerate garbage between the closing quote and the separator, like most parsers do
+    auto end = input.find_first_of(",\r\n", pos);
+    if (end == std::string_view::npos) end = input.size();
+    scratch.append(input.data() + pos, end - pos);
+    pos = end;
+
+    return scratch;
+}
+
+bool CSVReader::next(std::string_view& field, bool& rowEnd)
+{
+    if (!inRow)
+    {
+        // skip empty lines
+        while (pos < input.size() && (input[pos] == '\r' || input[pos] == '\n'))
+            skipRowEnd();
+
+        if (pos >= input.size()) return false;
+        inRow = true;
+    }
+
+    if (pos < input.size() && input[pos] == '"')
+        field = readQuoted();
+    else
+    {
+        auto end = input.find_first_of(",\r\n", pos);
+        if (end == std::string_view::npos) end = input.size();
+        field = input.substr(pos, end - pos);
+        pos   = end;
+    }
+
+    rowEnd = atRowEnd();
+    if (rowEnd)
+    {
+        skipRowEnd();
+        inRow = false;
+        row++;
+    }
+    else
+        pos++; // separator
+
+    return true;
+}
+
+void CSVReader::skipRow()
+{
+    std::string_view field;
+    bool rowEnd = false;
+    while (!rowEnd && next(field, rowEnd))
+        ;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/*
+ * Streaming RFC 4180 tokenizer over a CSV file in memory.
+ * Unquoted fields are handed out as views into the input, quoted fields are unescaped into a scratch buffer that
+ * stays valid until the next call. CRLF ends a row like LF, inside of quoted fields it is kept as it is.
+ */
+class CSVReader
+{
+    std::string_view input;
+    std::size_t pos = 0;
+    std::string scratch;
+    uint32_t row = 0;
+    bool inRow   = false;
+
+private:
+    std::string_view readQuoted();
+    bool atRowEnd() const { return pos >= input.size() || input[pos] == '\n' || input[pos] == '\r'; }
+    void skipRowEnd();
+
+public:
+    CSVReader(std::string_view input);
+
+    // Reads the next field. Returns false once the input is exhausted.
+    // rowEnd is set if the field is the last one of its row.
+    bool next(std::string_view& field, bool& rowEnd);
+    void skipRow();
+    // 0-based number of the row the next field belongs to
+    uint32_t currentRow() const { return row; }
+};
@@ -0,0 +1,43 @@
+#include "CSVWriter.hpp"
+
+CSVWriter::CSVWriter(std::ostream& sink, std::size_t bufferSize)
+    : sink(&sink)
+    , flushThreshold(bufferSize)
+{
+    buffer.reserve(bufferSize + bufferSize / 4);
+}
+
+CSVWriter::~CSVWriter() { flush(); }
+
+void CSVWriter::writeString(std::string_view value)
+{
+    separator();
+    buffer.push_back('"');
+
+    std::size_t start = 0;
+    for (auto pos = value.find('"'); pos != std::string_view::npos; pos = value.find('"', start))
+    {
+        buffer.append(value.data() + start, pos - start + 1);
+        buffer.push_back('"');
+        start = pos + 1;
+    }
+    buffer.append(value.data() + start, value.size() - start);
+
+    buffer.push_back('"');
+}
+
+void CSVWriter::flush()
+{
+    if (!sink || buffer.empty()) return;
+
+    sink->write(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    buffer.clear();
+}
+
+std::string CSVWriter::release()
+{
+    std::string result;
+    result.swap(buffer);
+    rowStart = true;
+    return result;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+/*
+ * Buffered RFC 4180 CSV emitter.
+ * Fields are formatted straight into one reusable buffer, which is handed to the sink in large blocks.
+ * Without a sink the buffer just grows and can be taken out with release().
+ */
+class CSVWriter
+{
+public:
+    static constexpr std::size_t DEFAULT_BUFFER_SIZE = 1 << 20;
+
+private:
+    std::ostream* sink = nullptr;
+    std::string buffer;
+    std::size_t flushThreshold = DEFAULT_BUFFER_SIZE;
+    bool rowStart              = true;
+
+private:
+    void separator()
+    {
+        if (!rowStart) buffer.push_back(',');
+        rowStart = false;
+    }
+
+    template<typename T, typename... Args>
+    void appendNumber(T value, Args... args)
+    {
+        char tmp[64];
+        auto result = std::to_chars(tmp, tmp + sizeof(tmp), value, args...);
+        buffer.append(tmp, result.ptr);
+    }
+
+public:
+    CSVWriter() = default;
+    explicit CSVWriter(std::ostream& sink, std::size_t bufferSize = DEFAULT_BUFFER_SIZE);
+    ~CSVWriter();
+
+    CSVWriter(const CSVWriter&)            = delete;
+    CSVWriter& operator=(const CSVWriter&) = delete;
+
+    void writeInt(int32_t value)
+    {
+        separator();
+        appendNumber(value);
+    }
+
+    // shortest representation that parses back to the same float
+    void writeFloat(float value)
+    {
+        separator();
+        appendNumber(value);
+    }
+
+    void writeDouble(double value)
+    {
+        separator();
+        appendNumber(value);
+    }
+
+    // quoted lowercase hex padded to 8 digits, the form unresolved hashes are written in
+    void writeHex(uint32_t value)
+    {
+        separator();
+        buffer.push_back('"');
+
+        char tmp[8];
+        auto result = std::to_chars(tmp, tmp + sizeof(tmp), value, 16);
+        buffer.append(sizeof(tmp) - (result.ptr - tmp), '0');
+        buffer.append(tmp, result.ptr);
+
+        buffer.push_back('"');
+    }
+
+    // always quoted, embedded quotes are doubled
+    void writeString(std::string_view value);
+
+    void endRow()
+    {
+        buffer.push_back('\n');
+        rowStart = true;
+        if (sink && buffer.size() >= flushThreshold) flush();
+    }
+
+    void flush();
+    std::string_view view() const { return buffer; }
+    std::string release();
+};
@@ -0,0 +1,202 @@
+#include "ColumnarTable.hpp"
+#include "Profiler.hpp"
+
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <functional>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    uint64_t align8(uint64_t value) { return (value + 7) & ~uint64_t(7); }
+
+    // strings in order of first use
+    class StringDictionary
+    {
+        std::unordered_map<std::string_view, uint32_t> indices;
+        std::vector<std::string_view> strings;
+
+    public:
+        uint32_t add(std::string_view string)
+        {
+            auto [itr, inserted] = indices.try_emplace(string, static_cast<uint32_t>(strings.size()));
+            if (inserted) strings.push_back(string);
+            return itr->second;
+        }
+
+        const std::vector<std::string_view>& get() const { return strings; }
+    };
+} // namespace
+
+ColumnarTable::ColumnarTable(MappedFile mapped)
+    : file(std::move(mapped))
+    , data(file.data())
+{
+    validate();
+}
+
+ColumnarTable::ColumnarTable(std::span<const char> data)
+    : data(data)
+{
+    validate();
+}
+
+bool ColumnarTable::isColumnar(std::span<const char> data)
+{
+    uint32_t magic = 0;
+    if (data.size() >= sizeof(magic)) std::memcpy(&magic, data.data(), sizeof(magic));
+    return magic == ColumnarHeader::MAGIC;
+}
+
+void ColumnarTable::validate()
+{
+    if (data.size() < sizeof(ColumnarHeader)) throw std::runtime_error("Columnar table is truncated.");
+
+    std::memcpy(&header, data.data(), sizeof(ColumnarHeader));
+    if (header.magic != ColumnarHeader::MAGIC) throw std::runtime_error("Not a columnar table.");
+    if (header.version != ColumnarHeader::VERSION)
+        throw std::runtime_error(std::format("Unsupported columnar table version {}.", header.version));
+
+    const uint64_t size = data.size();
+    const char* base    = data.data();
+
+    if (sizeof(ColumnarHeader) + static_cast<uint64_t>(header.columnCount) * sizeof(ColumnarColumn) > size)
+        throw std::runtime_error("Columnar table column list exceeds file size.");
+    columns = { reinterpret_cast<const ColumnarColumn*>(base + sizeof(ColumnarHeader)), header.columnCount };
+
+    const uint64_t offsetsEnd = header.stringOffsetsOffset + (static_cast<uint64_t>(header.stringCount) + 1) * 4;
+    if (header.stringOffsetsOffset % 4 != 0 || offsetsEnd > size ||
+        header.stringDataOffset + header.stringDataSize > size)
+        throw std::runtime_error("Columnar table strings exceed file size.");
+
+    stringOffsets = { reinterpret_cast<const uint32_t*>(base + header.stringOffsetsOffset), header.stringCount + 1 };
+    stringData    = base + header.stringDataOffset;
+
+    if (stringOffsets[header.stringCount] != header.stringDataSize)
+        throw std::runtime_error("Columnar table string offsets don't match the string data.");
+    for (uint32_t i = 0; i < header.stringCount; i++)
+        if (stringOffsets[i] >= stringOffsets[i + 1] || stringData[stringOffsets[i + 1] - 1] != '\0')
+            throw std::runtime_error(std::format("Columnar table string {} is malformed.", i));
+
+    for (auto& column : columns)
+    {
+        if (column.name >= header.stringCount) throw std::runtime_error("Columnar table column name is malformed.");
+
+        if (static_cast<uint32_t>(column.type) >= DATA_TYPE_TRAITS.size() ||
+            column.elementSize != getTypeTraits(column.type).size || column.elementSize == 0)
+            throw std::runtime_error(std::format("Column {} has an invalid type.", string(column.name)));
+
+        if (column.dataOffset + static_cast<uint64_t>(header.rowCount) * column.elementSize > size)
+            throw std::runtime_error(std::format("Column {} exceeds file size.", string(column.name)));
+    }
+}
+
+std::string_view ColumnarTable::string(uint32_t index) const
+{
+    if (index >= header.stringCount)
+        throw std::out_of_range(std::format("String index {} is out of range of the columnar table.", index));
+
+    return { stringData + stringOffsets[index], stringOffsets[index + 1] - stringOffsets[index] - 1 };
+}
+
+std::vector<char> ColumnarTable::encode(const CSVBView& view,
+                                        std::size_t table,
+                                        const RowCodec& codec,
+                                        std::span<const std::string> names)
+{
+    auto source = view.table(table);
+    return encode(source.row(0).data(),
+                  source.entryCount(),
+                  source.entrySize(),
+                  codec,
+                  names,
+                  [&](uint32_t offset) { return view.string(offset); });
+}
+
+std::vector<char> ColumnarTable::encode(const char* rows,
+                                        uint32_t rowCount,
+                                        std::size_t stride,
+                                        const RowCodec& codec,
+                                        std::span<const std::string> names,
+                                        const std::function<std::string_view(uint32_t)>& string)
+{
+    PROFILE_SCOPE("encode columnar");
+
+    if (names.size() != codec.fieldCount())
+        throw std::invalid_argument(std::format("Expected {} column names, got {}.", codec.fieldCount(), names.size()));
+
+    StringDictionary dictionary;
+    std::vector<ColumnarColumn> columns;
+    for (std::size_t i = 0; i < codec.fieldCount(); i++)
+        columns.push_back({ codec[i].type, codec[i].size, dictionary.add(names[i]), 0, 0 });
+
+    ColumnarHeader header{};
+    header.magic       = ColumnarHeader::MAGIC;
+    header.version     = ColumnarHeader::VERSION;
+    header.rowCount    = rowCount;
+    header.columnCount = static_cast<uint32_t>(columns.size());
+
+    uint64_t offset = align8(sizeof(ColumnarHeader) + columns.size() * sizeof(ColumnarColumn));
+    for (auto& column : columns)
+    {
+        column.dataOffset = offset;
+        offset            = align8(offset + static_cast<uint64_t>(header.rowCount) * column.elementSize);
+    }
+
+    std::vector<char> buffer(offset);
+    for (std::size_t i = 0; i < columns.size(); i++)
+    {
+        auto& field = codec[i];
+        auto* dest  = buffer.data() + columns[i].dataOffset;
+
+        for (uint32_t row = 0; row < header.rowCount; row++, dest += field.size)
+        {
+            auto* value = rows + row * stride + field.offset;
+            if (isStringRefType(field.type))
+            {
+                uint32_t offset;
+                std::memcpy(&offset, value, sizeof(offset));
+                auto index = dictionary.add(string(offset));
+                std::memcpy(dest, &index, sizeof(index));
+            }
+            else
+                std::memcpy(dest, value, field.size);
+        }
+    }
+
+    auto& strings = dictionary.get();
+    std::vector<uint32_t> stringOffsets{ 0 };
+    for (auto string : strings)
+        stringOffsets.push_back(stringOffsets.back() + static_cast<uint32_t>(string.size()) + 1);
+
+    header.stringCount         = static_cast<uint32_t>(strings.size());
+    header.stringDataSize      = stringOffsets.back();
+    header.stringOffsetsOffset = buffer.size();
+    header.stringDataOffset    = header.stringOffsetsOffset + stringOffsets.size() * sizeof(uint32_t);
+
+    buffer.resize(align8(header.stringDataOffset + header.stringDataSize));
+    std::memcpy(buffer.data() + header.stringOffsetsOffset, stringOffsets.data(), stringOffsets.size() * 4);
+    for (std::size_t i = 0; i < strings.size(); i++)
+        std::memcpy(buffer.data() + header.stringDataOffset + stringOffsets[i], strings[i].data(), strings[i].size());
+
+    std::memcpy(buffer.data(), &header, sizeof(header));
+    std::memcpy(buffer.data() + sizeof(header), columns.data(), columns.size() * sizeof(ColumnarColumn));
+
+    return buffer;
+}
+
+void ColumnarTable::write(const std::filesystem::path& path,
+                          const CSVBView& view,
+                          std::size_t table,
+                          const RowCodec& codec,
+                          std::span<const std::string> names)
+{
+    auto buffer = encode(view, table, codec, names);
+
+    std::ofstream output(path, std::ios::out | std::ios::binary);
+    output.write(buffer.data(), buffer.size());
+    if (!output) throw std::runtime_error("Error: failed to write " + path.string());
+}
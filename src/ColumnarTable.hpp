@@ -0,0 +1,98 @@
+#pragma once
+
+#include "CSVB.hpp"
+#include "MappedFile.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct ColumnarHeader
+{
+    static constexpr uint32_t MAGIC   = 'LOCC'; // "CCOL" in the file
+    static constexpr uint32_t VERSION = 1;
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t rowCount;
+    uint32_t columnCount;
+    uint32_t stringCount;
+    uint32_t stringDataSize;
+    uint64_t stringOffsetsOffset; // uint32_t[stringCount + 1]
+    uint64_t stringDataOffset;    // NUL terminated strings, string i starts at stringOffsets[i]
+};
+
+struct ColumnarColumn
+{
+    DataType type;
+    uint32_t elementSize; // bytes per value
+    uint32_t name;        // string index
+    uint32_t reserved;
+    uint64_t dataOffset; // rowCount values back to back
+};
+
+/*
+ * Binary columnar form of an extracted table, written instead of its CSV with --columnar.
+ * Every column is one contiguous array of its values as the CSVB stores them, except that string columns hold
+ * indices into a string dictionary shared by the whole table. All sections are 8 byte aligned, other tools can map
+ * the file and use it as is.
+ *
+ * Layout: ColumnarHeader, ColumnarColumn[columnCount], column arrays, string offsets, string data
+ */
+class ColumnarTable
+{
+    MappedFile file;
+    std::span<const char> data;
+    ColumnarHeader header{};
+    std::span<const ColumnarColumn> columns;
+    std::span<const uint32_t> stringOffsets;
+    const char* stringData = nullptr;
+
+private:
+    void validate();
+
+public:
+    // throws std::runtime_error if the file is malformed
+    explicit ColumnarTable(MappedFile mapped);
+    // views a table in memory, the data must outlive the object
+    explicit ColumnarTable(std::span<const char> data);
+
+    uint32_t rowCount() const { return header.rowCount; }
+    uint32_t columnCount() const { return header.columnCount; }
+    const ColumnarColumn& column(uint32_t index) const { return columns[index]; }
+    std::string_view columnName(uint32_t index) const { return string(columns[index].name); }
+    // elementSize bytes holding the value of a column in the given row
+    const char* value(uint32_t column, uint32_t row) const
+    {
+        auto& info = columns[column];
+        return data.data() + info.dataOffset + static_cast<std::size_t>(row) * info.elementSize;
+    }
+    std::string_view string(uint32_t index) const;
+    uint32_t stringCount() const { return header.stringCount; }
+
+    // encodes a table of a CSVB file, with one name per field of codec
+    static std::vector<char> encode(const CSVBView& view,
+                                    std::size_t table,
+                                    const RowCodec& codec,
+                                    std::span<const std::string> names);
+    // encodes rows laid out like in a CSVB file, stride bytes apart, string resolves the value of a string field
+    static std::vector<char> encode(const char* rows,
+                                    uint32_t rowCount,
+                                    std::size_t stride,
+                                    const RowCodec& codec,
+                                    std::span<const std::string> names,
+                                    const std::function<std::string_view(uint32_t)>& string);
+    static void write(const std::filesystem::path& path,
+                      const CSVBView& view,
+                      std::size_t table,
+                      const RowCodec& codec,
+                      std::span<const std::string> names);
+    // whether data starts like a columnar table
+    static bool isColumnar(std::span<const char> data);
+
+    static constexpr const char* EXTENSION = ".col";
+};
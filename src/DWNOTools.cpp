@@ -1,12 +1,482 @@
 ﻿#include "CSVB.hpp"
+#include "CSVBPatch.hpp"
+#include "Dictionary.hpp"
+#include "HashCracker.hpp"
+#include "PackManifest.hpp"
+#include "Profiler.hpp"
+#include "RoundTrip.hpp"
+#include "SearchIndex.hpp"
+#include "Server.hpp"
+#include "StructureRegistry.hpp"
+#include "ThreadPool.hpp"
 #include "utils.hpp"
 
 #include <boost/program_options.hpp>
 
+#include <algorithm>
+#include <chrono>
 #include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <map>
+#include <mutex>
+#include <optional>
 #include <string>
+#include <vector>
 
+// prints or writes what was recorded once main returns, whichever way it does
+struct ProfileReport
+{
+    bool stats = false;
+    std::string trace;
+
+    ~ProfileReport()
+    {
+        try
+        {
+            if (stats) Profiler::printSummary(std::cerr);
+            if (!trace.empty()) Profiler::writeTrace(trace);
+        }
+        catch (std::exception& e)
+        {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+};
+
+void extractDirectory(const std::filesystem::path& input,
+                      const std::filesystem::path& output,
+                      std::size_t jobs,
+                      bool columnar)
+{
+    std::vector<std::filesystem::path> files;
+    for (auto& path : std::filesystem::recursive_directory_iterator(input))
+        if (path.is_regular_file()) files.push_back(path.path());
+
+    // Files with the same name share one raw structure. The serial run leaves the one of the last file in
+    // iteration order on disk, so only let a file overwrite a raw structure written by an earlier one.
+    std::mutex rawMutex;
+    std::map<std::filesystem::path, std::size_t> rawOwners;
+
+    ThreadPool pool(jobs);
+    for (std::size_t i = 0; i < files.size(); i++)
+    {
+        pool.submit(
+            [&, i]
+            {
+                CSVBExporter exporter(files[i]);
+                if (!exporter.isValid()) return;
+
+                exporter.setColumnar(columnar);
+                exporter.write(output / std::filesystem::relative(files[i].parent_path(), input), false);
+
+                auto rawPath = exporter.getRawStructurePath();
+                std::lock_guard lock(rawMutex);
+                auto [itr, inserted] = rawOwners.try_emplace(rawPath, i);
+                if (!inserted && itr->second > i) return;
+
+                itr->second = i;
+                exporter.writeStructureJSON(rawPath);
+            });
+    }
+    pool.wait();
+}
+
+// folders with a structure and at least one of its tables as CSV or columnar file
+bool isPackable(const std::filesystem::path& folder)
+{
+    auto structure = StructureRegistry::find(folder, true);
+    if (!structure) return false;
+
+    for (auto& table : structure->tables)
+        if (std::filesystem::is_regular_file(CSVBImporter::getTablePath(folder, table.name))) return true;
+    return false;
+}
+
+int packDirectory(const std::filesystem::path& input,
+                  const std::filesystem::path& output,
+                  std::size_t jobs,
+                  bool mergeStrings,
+                  bool incremental)
+{
+    std::vector<std::filesystem::path> folders;
+    // an extracted folder given as root is packed into the output itself, like without --recursive
+    if (isPackable(input))
+        folders.push_back(input);
+    else
+    {
+        for (auto itr = std::filesystem::recursive_directory_iterator(input); itr != decltype(itr)(); ++itr)
+        {
+            if (!itr->is_directory() || !isPackable(itr->path())) continue;
+
+            folders.push_back(itr->path());
+            itr.disable_recursion_pending();
+        }
+    }
+    std::sort(folders.begin(), folders.end());
+
+    std::mutex resultMutex;
+    std::map<std::filesystem::path, std::string> errors;
+    std::size_t packed = 0;
+
+    // each task holds one folder's data at most, so the pool size bounds the memory use
+    ThreadPool pool(jobs);
+    for (auto& folder : folders)
+    {
+        pool.submit(
+            [&]
+            {
+                try
+                {
+                    auto target = folder == input ? output : output / std::filesystem::relative(folder, input);
+                    bool wrote  = true;
+                    if (incremental)
+                        wrote = packIncremental(folder, target, mergeStrings);
+                    else
+                    {
+                        CSVBImporter importer(folder, mergeStrings);
+                        importer.write(target);
+                    }
+
+                    std::lock_guard lock(resultMutex);
+                    if (wrote) packed++;
+                }
+                catch (std::exception& e)
+                {
+                    std::lock_guard lock(resultMutex);
+                    errors[folder] = e.what();
+                }
+            });
+    }
+    pool.wait();
+
+    for (auto& [folder, error] : errors)
+        std::cout << std::format("{}: {}", folder.string(), error) << std::endl;
+
+    auto upToDate = folders.size() - packed - errors.size();
+    std::cout << std::format("Packed {} of {} folders, {} up to date, {} failed.",
+                             packed,
+                             folders.size(),
+                             upToDate,
+                             errors.size())
+              << std::endl;
+
+    return errors.empty() ? 0 : 1;
+}
+
+void crackHashes(const std::filesystem::path& input, std::size_t jobs, const CrackSettings& settings)
+{
+    // share of the found names that may be chance matches before none of them can be trusted
+    constexpr double MAX_FALSE_POSITIVE_SHARE = 0.01;
+
+    HashCracker cracker;
+    cracker.addDictionary();
+
+    if (std::filesystem::is_directory(input))
+    {
+        for (auto& path : std::filesystem::recursive_directory_iterator(input))
+            if (path.is_regular_file()) cracker.addFile(path.path());
+    }
+    else
+        cracker.addFile(input);
+
+    auto rate = cracker.getFalsePositiveRate(settings);
+    std::cout << std::format("Searching names for {} hashes using {} words, {} candidates give {:.4f} false "
+                             "matches per hash.",
+                             cracker.getTargetCount(),
+                             cracker.getWordCount(),
+                             cracker.getCandidateCount(settings),
+                             rate)
+              << std::endl;
+
+    ThreadPool pool(jobs);
+    auto hits = cracker.run(pool, settings);
+
+    std::vector<std::string> names;
+    for (auto& [hash, candidates] : hits)
+    {
+        if (candidates.size() == 1)
+        {
+            std::cout << std::format("{:08x} -> {}", hash, *candidates.begin()) << std::endl;
+            names.push_back(*candidates.begin());
+            continue;
+        }
+
+        std::cout << std::format("{:08x} -> ambiguous, not added:", hash);
+        for (auto& candidate : candidates)
+            std::cout << " " << candidate;
+        std::cout << std::endl;
+    }
+
+    auto expected = rate * static_cast<double>(cracker.getTargetCount());
+    if (!names.empty() && expected > MAX_FALSE_POSITIVE_SHARE * static_cast<double>(hits.size()))
+    {
+        std::cout << std::format("Found {} names, but about {:.1f} of them are expected to be chance matches. "
+                                 "Check them and add the right ones to the dictionary yourself.",
+                                 hits.size(),
+                                 expected)
+                  << std::endl;
+        return;
+    }
+
+    auto target = Dictionary::getDictionaryPath() / "cracked.txt";
+    Dictionary::append(target, names);
+    std::cout << std::format("Found {} names, added {} to {}.", hits.size(), names.size(), target.string()) << std::endl;
+}
+
+std::string describePatch(const CSVBPatch& patch)
+{
+    std::string text;
+    for (auto& table : patch.tables)
+    {
+        auto matching = table.keyField == CSVBPatch::NO_KEY ? std::string("by position")
+                                                            : std::format("by field {}", table.keyField);
+        text += std::format("\n  {}: {} added, {} removed, {} changed, matched {}{}",
+                            table.name,
+                            table.added.size(),
+                            table.removed.size(),
+                            table.changed.size(),
+                            matching,
+                            table.order.empty() ? "" : ", reordered");
+    }
+    if (patch.replacesVariableData) text += "\n  variable data changed";
+    return text;
+}
+
+// returns whether the files differ
+bool diffFile(const std::filesystem::path& base,
+              const std::filesystem::path& target,
+              const std::optional<std::filesystem::path>& output,
+              std::string& report)
+{
+    MappedFile baseFile(base);
+    MappedFile targetFile(target);
+    if (std::ranges::equal(baseFile.data(), targetFile.data())) return false;
+
+    auto patch = CSVBPatch::diff(std::as_bytes(baseFile.data()), std::as_bytes(targetFile.data()));
+
+    report = patch.empty() ? "\n  only the layout differs" : describePatch(patch);
+    if (output) patch.write(*output);
+    return true;
+}
+
+int diffFiles(const std::filesystem::path& base,
+              const std::filesystem::path& target,
+              const std::optional<std::filesystem::path>& output,
+              std::size_t jobs)
+{
+    if (!std::filesystem::is_directory(base))
+    {
+        std::string report;
+        if (diffFile(base, target, output, report))
+            std::cout << std::format("{} differs:{}", target.string(), report) << std::endl;
+        else
+            std::cout << "The files are identical." << std::endl;
+        return 0;
+    }
+
+    std::vector<std::filesystem::path> files;
+    for (auto& path : std::filesystem::recursive_directory_iterator(base))
+        if (path.is_regular_file()) files.push_back(std::filesystem::relative(path.path(), base));
+    for (auto& path : std::filesystem::recursive_directory_iterator(target))
+    {
+        auto relative = std::filesystem::relative(path.path(), target);
+        if (path.is_regular_file() && !std::filesystem::exists(base / relative)) files.push_back(relative);
+    }
+
+    std::mutex resultMutex;
+    std::map<std::filesystem::path, std::string> results;
+    std::size_t changed = 0;
+
+    ThreadPool pool(jobs);
+    for (auto& file : files)
+    {
+        pool.submit(
+            [&]
+            {
+                std::string result;
+                try
+                {
+                    if (!std::filesystem::exists(target / file))
+                        result = " only in the base";
+                    else if (!std::filesystem::exists(base / file))
+                        result = " only in the target";
+                    else
+                    {
+                        std::optional<std::filesystem::path> patchPath;
+                        if (output) patchPath = *output / (file.string() + CSVBPatch::EXTENSION);
+                        if (!diffFile(base / file, target / file, patchPath, result)) return;
+                    }
+                }
+                catch (std::exception& e)
+                {
+                    result = std::format(" {}", e.what());
+                }
+
+                std::lock_guard lock(resultMutex);
+                results[file] = result;
+                changed++;
+            });
+    }
+    pool.wait();
+
+    for (auto& [file, result] : results)
+        std::cout << std::format("{}:{}", file.string(), result) << std::endl;
+    std::cout << std::format("{} of {} files differ.", changed, files.size()) << std::endl;
+
+    return 0;
+}
+
+void applyFile(const std::filesystem::path& input, const CSVBPatch& patch, const std::filesystem::path& output)
+{
+    MappedFile file(input);
+    auto result = patch.apply(std::as_bytes(file.data()));
+
+    if (output.has_parent_path()) std::filesystem::create_directories(output.parent_path());
+    std::ofstream stream(output, std::ios::out | std::ios::binary);
+    stream.write(reinterpret_cast<const char*>(result.data()), result.size());
+    if (!stream) throw std::runtime_error("Error: failed to write " + output.string());
+
+    // the rows match either way, only the packer's layout can differ from the original
+    auto fingerprint = makeHash64({ reinterpret_cast<const char*>(result.data()), result.size() });
+    if (fingerprint != patch.targetFingerprint)
+        std::cout << std::format("{}: the rows match, but the layout differs from the diffed file.", output.string())
+                  << std::endl;
+}
+
+int applyPatches(const std::filesystem::path& input,
+                 const std::filesystem::path& patches,
+                 const std::filesystem::path& output,
+                 std::size_t jobs)
+{
+    if (!std::filesystem::is_directory(patches))
+    {
+        applyFile(input, CSVBPatch::read(patches), output);
+        return 0;
+    }
+
+    std::vector<std::filesystem::path> files;
+    for (auto& path : std::filesystem::recursive_directory_iterator(patches))
+        if (path.is_regular_file() && path.path().extension() == CSVBPatch::EXTENSION)
+            files.push_back(std::filesystem::relative(path.path(), patches));
+
+    std::mutex resultMutex;
+    std::map<std::filesystem::path, std::string> errors;
+
+    ThreadPool pool(jobs);
+    for (auto& file : files)
+    {
+        pool.submit(
+            [&]
+            {
+                auto target = file;
+                target.replace_extension();
+                try
+                {
+                    applyFile(input / target, CSVBPatch::read(patches / file), output / target);
+                }
+                catch (std::exception& e)
+                {
+                    std::lock_guard lock(resultMutex);
+                    errors[target] = e.what();
+                }
+            });
+    }
+    pool.wait();
+
+    for (auto& [file, error] : errors)
+        std::cout << std::format("{}: {}", file.string(), error) << std::endl;
+    std::cout << std::format("Patched {} of {} files.", files.size() - errors.size(), files.size()) << std::endl;
+
+    return errors.empty() ? 0 : 1;
+}
+
+int verifyFiles(const std::filesystem::path& input, std::size_t jobs, bool columnar)
+{
+    std::vector<std::filesystem::path> files;
+    if (std::filesystem::is_directory(input))
+    {
+        for (auto& path : std::filesystem::recursive_directory_iterator(input))
+            if (path.is_regular_file()) files.push_back(path.path());
+    }
+    else
+        files.push_back(input);
+
+    std::mutex resultMutex;
+    std::map<std::filesystem::path, std::string> failures;
+    std::size_t verified = 0;
+
+    // every task holds one file and its conversion in memory at most
+    ThreadPool pool(jobs);
+    for (auto& file : files)
+    {
+        pool.submit(
+            [&]
+            {
+                std::string failure;
+                try
+                {
+                    MappedFile mapped(file);
+                    auto result = verifyRoundTrip(std::as_bytes(mapped.data()), file, columnar);
+                    if (!result) return;
+
+                    if (!result->identical)
+                        failure = std::format("differs at byte 0x{:x}, {}", result->offset, result->location);
+                }
+                catch (std::exception& e)
+                {
+                    failure = e.what();
+                }
+
+                std::lock_guard lock(resultMutex);
+                verified++;
+                if (!failure.empty()) failures[file] = failure;
+            });
+    }
+    pool.wait();
+
+    for (auto& [file, failure] : failures)
+        std::cout << std::format("{}: {}", file.string(), failure) << std::endl;
+    std::cout << std::format("Verified {} CSVB files, {} came out identical, {} didn't.",
+                             verified,
+                             verified - failures.size(),
+                             failures.size())
+              << std::endl;
+
+    return failures.empty() ? 0 : 1;
+}
+
+void findValue(const std::filesystem::path& input, const std::string& query, std::size_t jobs)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    SearchIndex index(input);
+    ThreadPool pool(jobs);
+    if (auto scanned = index.update(pool); scanned != 0)
+        std::cout << std::format("Indexed {} new or changed files.", scanned) << std::endl;
+
+    auto hits = index.find(query);
+    for (auto& hit : hits)
+        std::cout << std::format("{}: {} row {} {} ({})",
+                                 hit.file.string(),
+                                 hit.table,
+                                 hit.row,
+                                 hit.column,
+                                 SearchIndex::getKindName(hit.kind))
+                  << std::endl;
+
+    auto time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start);
+    std::cout << std::format("Found {} matches in {} files in {:.1f} ms.", hits.size(), index.fileCount(), time.count())
+              << std::endl;
+}
+
+// Extracting and packing have always run one job at a time unless told otherwise. The commands added since mostly
+// run on whole trees and wait on the CPU, so they use every core unless --jobs says otherwise.
+std::size_t getJobs(const boost::program_options::variables_map& vm, bool defaultToAllCores)
+{
+    if (defaultToAllCores && vm["jobs"].defaulted()) return 0;
+    return vm["jobs"].as<uint32_t>();
+}
 
 int main(int count, char* args[])
 {
@@ -26,10 +496,70 @@ int main(int count, char* args[])
         options(
             "pack,p",
             "Build a CSVB file out of the given input folder. The folder name must correspond to a valid structure.");
+        options("merge-strings",
+                "Let strings that end another string share its storage when packing. Makes the string section "
+                "smaller, but string offsets are no longer 4 byte aligned.");
+        options("recursive,r",
+                "Pack every extracted folder below the input folder into the same tree below the output folder. "
+                "Use --jobs to pack several folders at once.");
+        options("incremental",
+                "Only pack if a CSV, the structure or the options changed since the last incremental pack into the "
+                "same output. Unchanged tables are reused from structures/cache.");
         options("extract,x",
                 "Extract a CSVB out of a given file."
                 "A raw structure will be created in /structures/raw/, which is necessary for rebuilding."
                 "If a folder is given it will be recursively search for CSVB files in it.");
+        options("columnar",
+                "Extract every table as a binary .col file with one array per column instead of a CSV. Packing "
+                "reads a table's .col file if it has no CSV.");
+        options("crack",
+                "Search names for the hashes in the input file or folder that can't be resolved yet. "
+                "Unambiguous results are added to structures/dictionary/cracked.txt, unless the search space is "
+                "large enough for chance matches.");
+        options("crack-digits",
+                po::value<uint32_t>()->default_value(3)->notifier(
+                    [](uint32_t digits)
+                    {
+                        if (digits > CrackSettings::MAX_DIGITS)
+                            throw po::error(std::format("--crack-digits can be at most {}.", CrackSettings::MAX_DIGITS));
+                    }),
+                "Longest number tried in front of or after a word when using --crack, at most 6.");
+        options("crack-combine",
+                "Also try every pair of words when using --crack. Only possible with up to 2000 words, as "
+                "more pairs give too many collisions.");
+        options("diff",
+                po::value<std::vector<std::string>>()->multitoken(),
+                "Compare two CSVB files or folders of them row by row, given as <base> <target>. Rows are matched by "
+                "their first hash field. With --output a patch is written for every file that differs.");
+        options("apply",
+                po::value<std::string>(),
+                "Apply a patch file, or a folder of patches written by --diff, to the input and write the patched "
+                "files to the output.");
+        options("index",
+                "Build or update the search index of every CSVB file below the input folder, kept in "
+                "structures/cache. Only new and changed files are scanned.");
+        options("find",
+                po::value<std::string>(),
+                "Search the index of the input folder for rows with the given name, hash, number or string. Updates "
+                "the index first.");
+        options("verify",
+                "Extract and pack every CSVB file of the input file or folder in memory and report the files that "
+                "don't come out byte-identical, with the first byte and field that differs. Uses all cores unless "
+                "--jobs is given, with --columnar the tables are converted to columnar tables instead of CSV.");
+        options("serve",
+                "Keep running and answer extract, pack and hash requests, one JSON object per line on stdin, until "
+                "stdin is closed. Use --jobs to limit the number of requests handled at once.");
+        options("jobs,j",
+                po::value<uint32_t>()->default_value(1),
+                "Number of files to extract or folders to pack concurrently. A single file is extracted by as many "
+                "threads. 0 uses all cores, which is the default for all other commands.");
+        options("stats",
+                "Print the time spent in each phase, rows and bytes per table, rainbow table hits and allocations "
+                "to stderr when done.");
+        options("trace",
+                po::value<std::string>(),
+                "Write every timed phase of every thread to the given file as Chrome trace event JSON, for "
+                "chrome://tracing or Perfetto.");
 
         po::store(po::command_line_parser(count, args).options(desc).run(), vm);
         po::notify(vm);
@@ -40,6 +570,17 @@ int main(int count, char* args[])
             return 0;
         }
 
+        ProfileReport report;
+        report.stats = vm.count("stats") != 0;
+        if (vm.count("trace")) report.trace = vm["trace"].as<std::string>();
+#ifdef DWNO_PROFILING
+        if (report.stats || !report.trace.empty()) Profiler::enable(!report.trace.empty());
+#else
+        if (report.stats || !report.trace.empty())
+            std::cerr << "This build has no profiling instrumentation, ignoring --stats and --trace." << std::endl;
+        report = {};
+#endif
+
         if (vm.count("hash"))
         {
             auto string = vm["hash"].as<std::string>();
@@ -49,18 +590,77 @@ int main(int count, char* args[])
             return 0;
         }
 
+        if (vm.count("serve"))
+        {
+            auto jobs = getJobs(vm, true);
+            Server server(std::cout, jobs);
+            server.run(std::cin);
+            return 0;
+        }
+
+        if (vm.count("diff"))
+        {
+            auto paths = vm["diff"].as<std::vector<std::string>>();
+            if (paths.size() != 2)
+            {
+                std::cout << "--diff takes a base and a target path." << std::endl;
+                return 1;
+            }
+
+            auto jobs = getJobs(vm, true);
+            std::optional<std::filesystem::path> output;
+            if (vm.count("output")) output = vm["output"].as<std::string>();
+            return diffFiles(paths[0], paths[1], output, jobs);
+        }
+
         if (!vm.count("input"))
         {
             std::cout << "You must specify an input path." << std::endl;
             std::cout << desc << std::endl;
             return 1;
         }
+        if (vm.count("verify"))
+        {
+            auto jobs = getJobs(vm, true);
+            return verifyFiles(vm["input"].as<std::string>(), jobs, vm.count("columnar") != 0);
+        }
+        if (vm.count("index") || vm.count("find"))
+        {
+            auto jobs = getJobs(vm, true);
+            if (vm.count("find"))
+            {
+                findValue(vm["input"].as<std::string>(), vm["find"].as<std::string>(), jobs);
+                return 0;
+            }
+
+            SearchIndex index(vm["input"].as<std::string>());
+            ThreadPool pool(jobs);
+            auto scanned = index.update(pool);
+            std::cout << std::format("Indexed {} new or changed files, {} files in total.", scanned, index.fileCount())
+                      << std::endl;
+            return 0;
+        }
+        if (vm.count("crack"))
+        {
+            auto jobs = getJobs(vm, true);
+            CrackSettings settings;
+            settings.maxDigits    = vm["crack-digits"].as<uint32_t>();
+            settings.combineWords = vm.count("crack-combine") != 0;
+            crackHashes(vm["input"].as<std::string>(), jobs, settings);
+            return 0;
+        }
         if (!vm.count("output"))
         {
             std::cout << "You must specify an output path." << std::endl;
             std::cout << desc << std::endl;
             return 1;
         }
+        if (vm.count("apply"))
+        {
+            auto jobs = getJobs(vm, true);
+            return applyPatches(
+                vm["input"].as<std::string>(), vm["apply"].as<std::string>(), vm["output"].as<std::string>(), jobs);
+        }
         if ((vm.count("pack") + vm.count("extract")) != 1)
         {
             std::cout << "You must specify either --pack or --extract." << std::endl;
@@ -73,14 +673,31 @@ int main(int count, char* args[])
 
         if (vm.count("pack"))
         {
-            CSVBImporter importer(input);
+            bool mergeStrings = vm.count("merge-strings") != 0;
+            bool incremental  = vm.count("incremental") != 0;
+            if (vm.count("recursive"))
+                return packDirectory(input, output, getJobs(vm, false), mergeStrings, incremental);
+
+            if (incremental)
+            {
+                if (!packIncremental(input, output, mergeStrings))
+                    std::cout << output.string() << " is up to date." << std::endl;
+                return 0;
+            }
+
+            CSVBImporter importer(input, mergeStrings);
             importer.write(output);
             return 0;
         }
 
         if (vm.count("extract"))
         {
-            if (std::filesystem::is_directory(input))
+            auto jobs     = getJobs(vm, false);
+            bool columnar = vm.count("columnar") != 0;
+
+            if (std::filesystem::is_directory(input) && jobs != 1)
+                extractDirectory(input, output, jobs, columnar);
+            else if (std::filesystem::is_directory(input))
             {
                 std::filesystem::recursive_directory_iterator itr(input);
                 
@@ -89,6 +706,7 @@ int main(int count, char* args[])
                     if (!path.is_regular_file()) continue;
 
                     CSVBExporter exporter(path);
+                    exporter.setColumnar(columnar);
                     if (exporter.isValid())
                         exporter.write(output / std::filesystem::relative(path.path().parent_path(), input));
                 }
@@ -96,6 +714,8 @@ int main(int count, char* args[])
             else if (std::filesystem::is_regular_file(input))
             {
                 CSVBExporter exporter(input);
+                exporter.setColumnar(columnar);
+                exporter.setJobs(jobs);
                 if (exporter.isValid()) exporter.write(output);
             }
         }
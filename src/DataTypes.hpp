@@ -0,0 +1,136 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+enum class DataType : uint32_t
+{
+    DUMMY        = 0x00,
+    STRING       = 0x01,
+    INT32        = 0x02,
+    FLOAT        = 0x03,
+    FLAG         = 0x04,
+    INT16        = 0x05,
+    INT8         = 0x06,
+    VSTRING      = 0x07,
+    FX32         = 0x08,
+    STRING16     = 0x09,
+    DEF_INT32    = 0x0A,
+    DEF_FX32     = 0x0B,
+    DEF_STRING   = 0x0C,
+    VSTRING_UTF  = 0x0D,
+    STRING4      = 0x0E,
+    STRING8      = 0x0F,
+    STRING12     = 0x10,
+    DEF_STRING4  = 0x11,
+    DEF_STRING8  = 0x12,
+    DEF_STRING12 = 0x13,
+    DEF_STRING16 = 0x14,
+    CHAR4        = 0x15,
+    CHAR8        = 0x16,
+    DEF_CHAR4    = 0x17,
+    DEF_CHAR8    = 0x18,
+    HASH32       = 0x19,
+    DEF_HASH32   = 0x1A,
+    VSTRING_UTF8 = 0x1B,
+    DEF_SHORT    = 0x1C
+};
+
+enum class FieldKind
+{
+    INTEGER,       // signed little endian integer of the field's size
+    FLOAT,         // IEEE 754 single precision
+    FIXED,         // signed 20.12 fixed point
+    HASH,          // makeHash of a name
+    STRING_REF,    // offset into the string section
+    INLINE_STRING, // zero padded text inside the row
+    UNSUPPORTED,   // size and meaning unknown
+};
+
+struct DataTypeTraits
+{
+    DataType type;
+    std::string_view name; // key used in the structure files
+    uint32_t size;
+    FieldKind kind;
+};
+
+// indexed by DataType, the DEF_ variants are stored like their plain counterparts
+inline constexpr std::array<DataTypeTraits, 29> DATA_TYPE_TRAITS{ {
+    { DataType::DUMMY, "dummy", 0, FieldKind::UNSUPPORTED },
+    { DataType::STRING, "string", 0, FieldKind::UNSUPPORTED },
+    { DataType::INT32, "int", 4, FieldKind::INTEGER },
+    { DataType::FLOAT, "float", 4, FieldKind::FLOAT },
+    { DataType::FLAG, "flag", 0, FieldKind::UNSUPPORTED },
+    { DataType::INT16, "int16", 2, FieldKind::INTEGER },
+    { DataType::INT8, "int8", 1, FieldKind::INTEGER },
+    { DataType::VSTRING, "vstring", 4, FieldKind::STRING_REF },
+    { DataType::FX32, "fx32", 4, FieldKind::FIXED },
+    { DataType::STRING16, "string16", 16, FieldKind::INLINE_STRING },
+    { DataType::DEF_INT32, "def_int", 4, FieldKind::INTEGER },
+    { DataType::DEF_FX32, "def_fx32", 4, FieldKind::FIXED },
+    { DataType::DEF_STRING, "def_string", 0, FieldKind::UNSUPPORTED },
+    { DataType::VSTRING_UTF, "vstring_utf", 4, FieldKind::STRING_REF },
+    { DataType::STRING4, "string4", 4, FieldKind::INLINE_STRING },
+    { DataType::STRING8, "string8", 8, FieldKind::INLINE_STRING },
+    { DataType::STRING12, "string12", 12, FieldKind::INLINE_STRING },
+    { DataType::DEF_STRING4, "def_string4", 4, FieldKind::INLINE_STRING },
+    { DataType::DEF_STRING8, "def_string8", 8, FieldKind::INLINE_STRING },
+    { DataType::DEF_STRING12, "def_string12", 12, FieldKind::INLINE_STRING },
+    { DataType::DEF_STRING16, "def_string16", 16, FieldKind::INLINE_STRING },
+    { DataType::CHAR4, "char4", 4, FieldKind::INLINE_STRING },
+    { DataType::CHAR8, "char8", 8, FieldKind::INLINE_STRING },
+    { DataType::DEF_CHAR4, "def_char4", 4, FieldKind::INLINE_STRING },
+    { DataType::DEF_CHAR8, "def_char8", 8, FieldKind::INLINE_STRING },
+    { DataType::HASH32, "hash", 4, FieldKind::HASH },
+    { DataType::DEF_HASH32, "def_hash", 4, FieldKind::HASH },
+    { DataType::VSTRING_UTF8, "vstring8", 4, FieldKind::STRING_REF },
+    { DataType::DEF_SHORT, "def_short", 2, FieldKind::INTEGER },
+} };
+
+static_assert(
+    []
+    {
+        for (uint32_t i = 0; i < DATA_TYPE_TRAITS.size(); i++)
+            if (static_cast<uint32_t>(DATA_TYPE_TRAITS[i].type) != i) return false;
+        return true;
+    }(),
+    "DATA_TYPE_TRAITS must be indexed by DataType");
+
+constexpr const DataTypeTraits& getTypeTraits(DataType type)
+{
+    auto index = static_cast<uint32_t>(type);
+    if (index >= DATA_TYPE_TRAITS.size())
+        throw std::invalid_argument("Tried using undefined DataType: " + std::to_string(index));
+    return DATA_TYPE_TRAITS[index];
+}
+
+constexpr std::optional<DataType> findDataType(std::string_view name)
+{
+    for (auto& traits : DATA_TYPE_TRAITS)
+        if (traits.name == name) return traits.type;
+    return std::nullopt;
+}
+
+constexpr bool isHashType(DataType type) { return getTypeTraits(type).kind == FieldKind::HASH; }
+constexpr bool isStringRefType(DataType type) { return getTypeTraits(type).kind == FieldKind::STRING_REF; }
+
+// integer type to load a field of the given size as
+template<uint32_t SIZE>
+using IntegerOf = std::conditional_t<SIZE == 1, int8_t, std::conditional_t<SIZE == 2, int16_t, int32_t>>;
+
+// table of Codec<type>::apply for every DataType, built at compile time
+template<template<DataType> typename Codec>
+constexpr auto makeCodecTable()
+{
+    return []<std::size_t... I>(std::index_sequence<I...>)
+    {
+        return std::array{ &Codec<static_cast<DataType>(I)>::apply... };
+    }(std::make_index_sequence<DATA_TYPE_TRAITS.size()>());
+}
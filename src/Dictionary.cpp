@@ -0,0 +1,178 @@
+#include "Dictionary.hpp"
+#include "ThreadPool.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <format>
+#include <fstream>
+
+namespace
+{
+    // names generated by a single expansion task
+    constexpr uint32_t CHUNK_SIZE = 4096;
+
+    void feed(uint64_t& hash, std::string_view data)
+    {
+        for (auto c : data)
+        {
+            hash ^= static_cast<uint8_t>(c);
+            hash *= 1099511628211ull;
+        }
+        hash ^= 0xFF;
+        hash *= 1099511628211ull;
+    }
+
+    std::string_view trim(std::string_view line)
+    {
+        auto start = line.find_first_not_of(" \t\r");
+        if (start == std::string_view::npos) return {};
+        auto end = line.find_last_not_of(" \t\r");
+        return line.substr(start, end - start + 1);
+    }
+} // namespace
+
+std::filesystem::path Dictionary::getDictionaryPath() { return getStructuresPath() / "dictionary"; }
+
+Dictionary::Dictionary(const std::filesystem::path& folder)
+{
+    std::vector<std::filesystem::path> files;
+    if (std::filesystem::is_directory(folder))
+        for (auto& entry : std::filesystem::directory_iterator(folder))
+            if (entry.is_regular_file() && entry.path().extension() == ".txt") files.push_back(entry.path());
+
+    std::sort(files.begin(), files.end());
+
+    for (auto& file : files)
+        addFile(file);
+}
+
+void Dictionary::addFile(const std::filesystem::path& path)
+{
+    auto contents = getFileAsString(path);
+    feed(fingerprint, path.filename().string());
+    feed(fingerprint, contents);
+
+    std::string_view view(contents);
+    uint32_t lineNumber = 0;
+
+    while (!view.empty())
+    {
+        auto end  = view.find('\n');
+        auto line = trim(view.substr(0, end));
+        view      = end == std::string_view::npos ? std::string_view() : view.substr(end + 1);
+        lineNumber++;
+
+        if (line.empty() || line.starts_with('#')) continue;
+
+        // "<pattern> <count>"
+        auto split = line.find_last_of(" \t");
+        if (line.find('{') != std::string_view::npos && split != std::string_view::npos)
+        {
+            auto countStr = line.substr(split + 1);
+            uint32_t count;
+            auto result = std::from_chars(countStr.data(), countStr.data() + countStr.size(), count);
+            if (result.ec == std::errc() && result.ptr == countStr.data() + countStr.size() && count > 0)
+            {
+                Generator generator{ std::string(trim(line.substr(0, split))), count };
+                try
+                {
+                    static_cast<void>(std::vformat(generator.format, std::make_format_args(count)));
+                }
+                catch (std::exception& e)
+                {
+                    throw std::runtime_error(
+                        std::format("{}:{}: invalid pattern: {}", path.string(), lineNumber, e.what()));
+                }
+                generators.push_back(std::move(generator));
+                continue;
+            }
+        }
+
+        generators.push_back({ std::string(line) });
+    }
+}
+
+void Dictionary::expand(ThreadPool& threadPool, std::vector<Name>& names, std::string& strings) const
+{
+    struct Chunk
+    {
+        const Generator* generator;
+        uint32_t begin;
+        uint32_t end;
+        std::vector<Name> names = {};
+        std::string strings     = {};
+    };
+
+    std::vector<Chunk> chunks;
+    for (auto& generator : generators)
+    {
+        if (generator.count == 0)
+        {
+            if (chunks.empty() || chunks.back().generator->count != 0) chunks.push_back({ &generator, 0, 0 });
+            chunks.back().end++;
+            continue;
+        }
+
+        for (uint32_t begin = 0; begin < generator.count; begin += CHUNK_SIZE)
+            chunks.push_back({ &generator, begin, std::min(generator.count, begin + CHUNK_SIZE) });
+    }
+
+    for (auto& chunk : chunks)
+    {
+        threadPool.submit(
+            [&chunk]
+            {
+                auto add = [&chunk](std::string_view name)
+                {
+                    auto offset = static_cast<uint32_t>(chunk.strings.size());
+                    chunk.names.push_back({ 0, offset, static_cast<uint32_t>(name.size()) });
+                    chunk.strings.append(name);
+                };
+
+                // a plain name chunk covers a run of consecutive names
+                if (chunk.generator->count == 0)
+                {
+                    for (uint32_t i = 0; i < chunk.end; i++)
+                        add(chunk.generator[i].format);
+                }
+                else
+                {
+                    for (uint32_t i = chunk.begin; i < chunk.end; i++)
+                        add(std::vformat(chunk.generator->format, std::make_format_args(i)));
+                }
+
+                // hash the whole chunk at once, once its strings don't move anymore
+                std::vector<std::string_view> views;
+                std::vector<uint32_t> hashes(chunk.names.size());
+                views.reserve(chunk.names.size());
+                for (auto& name : chunk.names)
+                    views.emplace_back(chunk.strings.data() + name.offset, name.length);
+
+                makeHashes(views, hashes);
+                for (std::size_t i = 0; i < hashes.size(); i++)
+                    chunk.names[i].hash = hashes[i];
+            });
+    }
+    threadPool.wait();
+
+    for (auto& chunk : chunks)
+    {
+        auto base = static_cast<uint32_t>(strings.size());
+        for (auto name : chunk.names)
+        {
+            name.offset += base;
+            names.push_back(name);
+        }
+        strings.append(chunk.strings);
+    }
+}
+
+void Dictionary::append(const std::filesystem::path& path, const std::vector<std::string>& names)
+{
+    if (path.has_parent_path()) std::filesystem::create_directories(path.parent_path());
+
+    std::ofstream output(path, std::ios::app);
+    for (auto& name : names)
+        output << name << "\n";
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class ThreadPool;
+
+/*
+ * Word lists and name patterns used to fill the RainbowTable.
+ * Every .txt file in the dictionary folder is loaded. Each line is either a plain name or a std::format pattern
+ * followed by a count, e.g. "item_food_{:03} 1000", which generates the pattern for 0 up to the count.
+ */
+class Dictionary
+{
+public:
+    struct Generator
+    {
+        std::string format;
+        uint32_t count = 0; // 0 for plain names
+    };
+
+    struct Name
+    {
+        uint32_t hash;
+        uint32_t offset;
+        uint32_t length;
+    };
+
+private:
+    std::vector<Generator> generators;
+    uint64_t fingerprint = 14695981039346656037ull;
+
+private:
+    void addFile(const std::filesystem::path& path);
+
+public:
+    Dictionary() = default;
+    explicit Dictionary(const std::filesystem::path& folder);
+
+    const std::vector<Generator>& getGenerators() const { return generators; }
+    // changes whenever any of the loaded files does
+    uint64_t getFingerprint() const { return fingerprint; }
+
+    // Expands all generators into hashed names stored back to back in pool, in dictionary order.
+    void expand(ThreadPool& pool, std::vector<Name>& names, std::string& strings) const;
+
+    static std::filesystem::path getDictionaryPath();
+    // appends plain names to a dictionary file, creating it if needed
+    static void append(const std::filesystem::path& path, const std::vector<std::string>& names);
+};
@@ -0,0 +1,302 @@
+#include "utils.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <type_traits>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#    define DWNO_X86
+#    include <immintrin.h>
+#    if defined(_MSC_VER) && !defined(__clang__)
+#        include <intrin.h>
+#        define TARGET_SSE41
+#        define TARGET_AVX2
+#    else
+#        define TARGET_SSE41 __attribute__((target("sse4.1")))
+#        define TARGET_AVX2  __attribute__((target("avx2")))
+#    endif
+#endif
+
+namespace
+{
+    constexpr uint32_t FNV_OFFSET = 2166136261u;
+    constexpr uint32_t FNV_PRIME  = 16777619u;
+    constexpr bool SIGNED_CHAR    = std::is_signed_v<char>;
+
+    // the character as makeHash xors it in, including the sign extension of char
+    inline uint32_t widen(char c) { return static_cast<uint32_t>(static_cast<int32_t>(c)); }
+
+    using HashFunction   = void (*)(const std::string_view*, uint32_t*, std::size_t);
+    using ExtendFunction = void (*)(const uint32_t*, uint32_t*, std::size_t, std::string_view);
+
+    void makeHashesScalar(const std::string_view* inputs, uint32_t* outputs, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; i++)
+            outputs[i] = makeHash(inputs[i]);
+    }
+
+    void extendHashesScalar(const uint32_t* states, uint32_t* out, std::size_t count, std::string_view suffix)
+    {
+        std::copy(states, states + count, out);
+        for (char c : suffix)
+            for (std::size_t i = 0; i < count; i++)
+                out[i] = hashStep(out[i], c);
+    }
+
+#ifdef DWNO_X86
+    // the next four characters of a string starting at pos, zero padded past its end
+    inline uint32_t loadWord(std::string_view input, std::size_t pos)
+    {
+        uint32_t word = 0;
+        if (pos + 4 <= input.size())
+            std::memcpy(&word, input.data() + pos, 4);
+        else if (pos < input.size())
+            std::memcpy(&word, input.data() + pos, input.size() - pos);
+        return word;
+    }
+
+    // lanes idle once their string ended, groups of very different lengths are faster the scalar way
+    template<std::size_t LANES>
+    bool isBalanced(const std::string_view* inputs, std::size_t& maxLength)
+    {
+        std::size_t total = 0;
+        maxLength         = 0;
+        for (std::size_t lane = 0; lane < LANES; lane++)
+        {
+            total += inputs[lane].size();
+            maxLength = std::max(maxLength, inputs[lane].size());
+        }
+        return maxLength <= INT32_MAX && total * 4 >= maxLength * LANES * 3;
+    }
+
+    TARGET_SSE41 void makeHashesSSE41(const std::string_view* inputs, uint32_t* outputs, std::size_t count)
+    {
+        const auto prime = _mm_set1_epi32(FNV_PRIME);
+
+        std::size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            auto* in = inputs + i;
+
+            std::size_t maxLength;
+            if (!isBalanced<4>(in, maxLength))
+            {
+                makeHashesScalar(in, outputs + i, 4);
+                continue;
+            }
+
+            auto lengths = _mm_setr_epi32(static_cast<int32_t>(in[0].size()),
+                                          static_cast<int32_t>(in[1].size()),
+                                          static_cast<int32_t>(in[2].size()),
+                                          static_cast<int32_t>(in[3].size()));
+            auto state   = _mm_set1_epi32(static_cast<int32_t>(FNV_OFFSET));
+
+            // four characters per lane are loaded at once, then fed one by one
+            for (std::size_t pos = 0; pos < maxLength; pos += 4)
+            {
+                auto words = _mm_setr_epi32(static_cast<int32_t>(loadWord(in[0], pos)),
+                                            static_cast<int32_t>(loadWord(in[1], pos)),
+                                            static_cast<int32_t>(loadWord(in[2], pos)),
+                                            static_cast<int32_t>(loadWord(in[3], pos)));
+
+                for (std::size_t k = 0; k < 4 && pos + k < maxLength; k++)
+                {
+                    // widened the same way as the char makeHash xors in
+                    auto shift = _mm_cvtsi32_si128(24 - 8 * static_cast<int>(k));
+                    auto bytes = _mm_sll_epi32(words, shift);
+                    auto c     = SIGNED_CHAR ? _mm_srai_epi32(bytes, 24) : _mm_srli_epi32(bytes, 24);
+                    auto mask  = _mm_cmpgt_epi32(lengths, _mm_set1_epi32(static_cast<int32_t>(pos + k)));
+                    auto next  = _mm_xor_si128(_mm_mullo_epi32(state, prime), c);
+                    state      = _mm_blendv_epi8(state, next, mask);
+                }
+            }
+
+            alignas(16) uint32_t result[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(result), state);
+            for (std::size_t lane = 0; lane < 4; lane++)
+                outputs[i + lane] = in[lane].empty() ? 0xFFFFFFFF : result[lane];
+        }
+
+        makeHashesScalar(inputs + i, outputs + i, count - i);
+    }
+
+    TARGET_AVX2 void makeHashesAVX2(const std::string_view* inputs, uint32_t* outputs, std::size_t count)
+    {
+        const auto prime = _mm256_set1_epi32(FNV_PRIME);
+
+        std::size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            auto* in = inputs + i;
+
+            std::size_t maxLength;
+            if (!isBalanced<8>(in, maxLength))
+            {
+                makeHashesScalar(in, outputs + i, 8);
+                continue;
+            }
+
+            auto lengths = _mm256_setr_epi32(static_cast<int32_t>(in[0].size()),
+                                             static_cast<int32_t>(in[1].size()),
+                                             static_cast<int32_t>(in[2].size()),
+                                             static_cast<int32_t>(in[3].size()),
+                                             static_cast<int32_t>(in[4].size()),
+                                             static_cast<int32_t>(in[5].size()),
+                                             static_cast<int32_t>(in[6].size()),
+                                             static_cast<int32_t>(in[7].size()));
+            auto state   = _mm256_set1_epi32(static_cast<int32_t>(FNV_OFFSET));
+
+            for (std::size_t pos = 0; pos < maxLength; pos += 4)
+            {
+                auto words = _mm256_setr_epi32(static_cast<int32_t>(loadWord(in[0], pos)),
+                                               static_cast<int32_t>(loadWord(in[1], pos)),
+                                               static_cast<int32_t>(loadWord(in[2], pos)),
+                                               static_cast<int32_t>(loadWord(in[3], pos)),
+                                               static_cast<int32_t>(loadWord(in[4], pos)),
+                                               static_cast<int32_t>(loadWord(in[5], pos)),
+                                               static_cast<int32_t>(loadWord(in[6], pos)),
+                                               static_cast<int32_t>(loadWord(in[7], pos)));
+
+                for (std::size_t k = 0; k < 4 && pos + k < maxLength; k++)
+                {
+                    auto shift = _mm_cvtsi32_si128(24 - 8 * static_cast<int>(k));
+                    auto bytes = _mm256_sll_epi32(words, shift);
+                    auto c     = SIGNED_CHAR ? _mm256_srai_epi32(bytes, 24) : _mm256_srli_epi32(bytes, 24);
+                    auto mask  = _mm256_cmpgt_epi32(lengths, _mm256_set1_epi32(static_cast<int32_t>(pos + k)));
+                    auto next  = _mm256_xor_si256(_mm256_mullo_epi32(state, prime), c);
+                    state      = _mm256_blendv_epi8(state, next, mask);
+                }
+            }
+
+            alignas(32) uint32_t result[8];
+            _mm256_store_si256(reinterpret_cast<__m256i*>(result), state);
+            for (std::size_t lane = 0; lane < 8; lane++)
+                outputs[i + lane] = in[lane].empty() ? 0xFFFFFFFF : result[lane];
+        }
+
+        makeHashesSSE41(inputs + i, outputs + i, count - i);
+    }
+
+    TARGET_SSE41 void
+    extendHashesSSE41(const uint32_t* states, uint32_t* out, std::size_t count, std::string_view suffix)
+    {
+        const auto prime = _mm_set1_epi32(FNV_PRIME);
+
+        std::size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            auto s = _mm_loadu_si128(reinterpret_cast<const __m128i*>(states + i));
+            for (char c : suffix)
+                s = _mm_xor_si128(_mm_mullo_epi32(s, prime), _mm_set1_epi32(static_cast<int32_t>(widen(c))));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), s);
+        }
+        extendHashesScalar(states + i, out + i, count - i, suffix);
+    }
+
+    TARGET_AVX2 void extendHashesAVX2(const uint32_t* states, uint32_t* out, std::size_t count, std::string_view suffix)
+    {
+        const auto prime = _mm256_set1_epi32(FNV_PRIME);
+
+        std::size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            auto s = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(states + i));
+            for (char c : suffix)
+                s = _mm256_xor_si256(_mm256_mullo_epi32(s, prime), _mm256_set1_epi32(static_cast<int32_t>(widen(c))));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), s);
+        }
+        extendHashesSSE41(states + i, out + i, count - i, suffix);
+    }
+
+    HashBackend detectBackend()
+    {
+#    if defined(_MSC_VER) && !defined(__clang__)
+        int info[4];
+        __cpuid(info, 0);
+        const int maxLeaf = info[0];
+
+        __cpuid(info, 1);
+        const bool sse41   = (info[2] & (1 << 19)) != 0;
+        const bool osxsave = (info[2] & (1 << 27)) != 0;
+        const bool avx     = (info[2] & (1 << 28)) != 0;
+
+        bool avx2 = false;
+        if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+        {
+            __cpuidex(info, 7, 0);
+            avx2 = (info[1] & (1 << 5)) != 0;
+        }
+#    else
+        __builtin_cpu_init();
+        const bool sse41 = __builtin_cpu_supports("sse4.1");
+        const bool avx2  = __builtin_cpu_supports("avx2");
+#    endif
+
+        if (avx2) return HashBackend::AVX2;
+        if (sse41) return HashBackend::SSE41;
+        return HashBackend::SCALAR;
+    }
+#else
+    HashBackend detectBackend() { return HashBackend::SCALAR; }
+#endif
+
+    struct Dispatch
+    {
+        HashBackend backend;
+        HashFunction hash;
+        ExtendFunction extend;
+    };
+
+    Dispatch select(HashBackend backend)
+    {
+        switch (backend)
+        {
+#ifdef DWNO_X86
+            case HashBackend::AVX2: return { backend, makeHashesAVX2, extendHashesAVX2 };
+            case HashBackend::SSE41: return { backend, makeHashesSSE41, extendHashesSSE41 };
+#endif
+            default: return { HashBackend::SCALAR, makeHashesScalar, extendHashesScalar };
+        }
+    }
+
+    Dispatch& getDispatch()
+    {
+        static Dispatch dispatch = select(detectBackend());
+        return dispatch;
+    }
+} // namespace
+
+void makeHashes(std::span<const std::string_view> inputs, std::span<uint32_t> outputs)
+{
+    if (outputs.size() < inputs.size()) throw std::invalid_argument("makeHashes: output span too small.");
+    getDispatch().hash(inputs.data(), outputs.data(), inputs.size());
+}
+
+void extendHashes(std::span<const uint32_t> states, std::span<uint32_t> outputs, std::string_view suffix)
+{
+    if (outputs.size() < states.size()) throw std::invalid_argument("extendHashes: output span too small.");
+    getDispatch().extend(states.data(), outputs.data(), states.size(), suffix);
+}
+
+HashBackend getHashBackend() { return getDispatch().backend; }
+
+void setHashBackend(HashBackend backend)
+{
+    if (backend > detectBackend())
+        throw std::invalid_argument(
+            std::format("Hash backend {} is not supported by this CPU.", getHashBackendName(backend)));
+    getDispatch() = select(backend);
+}
+
+std::string_view getHashBackendName(HashBackend backend)
+{
+    switch (backend)
+    {
+        case HashBackend::SCALAR: return "scalar";
+        case HashBackend::SSE41: return "sse4.1";
+        case HashBackend::AVX2: return "avx2";
+    }
+    return "unknown";
+}
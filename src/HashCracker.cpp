@@ -0,0 +1,245 @@
+#include "HashCracker.hpp"
+#include "CSVB.hpp"
+#include "Dictionary.hpp"
+#include "ThreadPool.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <format>
+#include <mutex>
+#include <stdexcept>
+
+namespace
+{
+    constexpr uint32_t FILTER_BITS     = 22;
+    constexpr std::size_t MAX_WORD     = 32;  // longer strings are unlikely to be part of a name
+    constexpr std::size_t BLOCK        = 256; // prefixes extended together
+    constexpr std::size_t SUFFIXES     = 64;  // suffixes per task
+    constexpr const char* SEPARATORS[] = { "", "_" };
+
+    uint64_t getDigitCount(uint32_t maxDigits)
+    {
+        uint64_t count = 0;
+        uint64_t limit = 1;
+        for (uint32_t width = 1; width <= maxDigits; width++)
+        {
+            limit *= 10;
+            count += limit;
+        }
+        return count;
+    }
+
+    std::vector<std::string> makeDigits(uint32_t maxDigits)
+    {
+        std::vector<std::string> digits;
+        uint64_t limit = 1;
+        for (uint32_t width = 1; width <= maxDigits; width++)
+        {
+            limit *= 10;
+            for (uint64_t i = 0; i < limit; i++)
+                digits.push_back(std::format("{:0{}}", i, width));
+        }
+        return digits;
+    }
+} // namespace
+
+HashCracker::HashCracker()
+    : filter((1ull << FILTER_BITS) / 64)
+{
+}
+
+bool HashCracker::isTarget(uint32_t hash) const
+{
+    auto bit = hash & ((1u << FILTER_BITS) - 1);
+    if ((filter[bit / 64] & (1ull << (bit % 64))) == 0) return false;
+    return targets.contains(hash);
+}
+
+void HashCracker::addTarget(uint32_t hash)
+{
+    auto bit = hash & ((1u << FILTER_BITS) - 1);
+    filter[bit / 64] |= 1ull << (bit % 64);
+    targets.insert(hash);
+}
+
+void HashCracker::addWord(std::string_view word)
+{
+    if (word.empty() || word.size() > MAX_WORD) return;
+    if (std::any_of(word.begin(), word.end(), [](char c) { return std::isspace(static_cast<unsigned char>(c)); }))
+        return;
+
+    auto addVariants = [this](std::string_view value)
+    {
+        if (value.empty()) return;
+
+        std::string str(value);
+        words.insert(str);
+        std::transform(str.begin(), str.end(), str.begin(), [](unsigned char c) { return std::tolower(c); });
+        words.insert(str);
+        std::transform(str.begin(), str.end(), str.begin(), [](unsigned char c) { return std::toupper(c); });
+        words.insert(str);
+    };
+
+    addVariants(word);
+
+    // leading parts, e.g. "evo_dojo" of "evo_dojo_bonds"
+    for (auto pos = word.find('_'); pos != std::string_view::npos; pos = word.find('_', pos + 1))
+        addVariants(word.substr(0, pos));
+
+    // parts between separators and digits
+    std::size_t start = 0;
+    for (std::size_t i = 0; i <= word.size(); i++)
+    {
+        if (i < word.size() && word[i] != '_' && !std::isdigit(static_cast<unsigned char>(word[i]))) continue;
+        if (i > start && (start != 0 || i != word.size())) addVariants(word.substr(start, i - start));
+        start = i + 1;
+    }
+}
+
+void HashCracker::addFile(const std::filesystem::path& path)
+{
+    MappedFile file(path);
+    CSVBView view(file.data());
+    if (!view.isValid()) return;
+
+    for (std::size_t t = 0; t < view.tableCount(); t++)
+    {
+        auto table = view.table(t);
+        RowCodec codec(table.types());
+
+        for (uint32_t i = 0; i < table.entryCount(); i++)
+        {
+            auto row = table.row(i);
+            for (auto& field : codec)
+            {
+                if (isHashType(field.type))
+                {
+                    auto hash = row.get<uint32_t>(field.offset);
+                    if (!RainbowTable::hasHash(hash)) addTarget(hash);
+                }
+                else if (isStringRefType(field.type))
+                    addWord(view.string(row.get<uint32_t>(field.offset)));
+            }
+        }
+    }
+}
+
+void HashCracker::addDictionary()
+{
+    Dictionary dictionary(Dictionary::getDictionaryPath());
+
+    for (auto& generator : dictionary.getGenerators())
+    {
+        std::string_view format = generator.format;
+        if (generator.count == 0)
+        {
+            addWord(format);
+            continue;
+        }
+
+        // literal text in front of the first replacement field, e.g. "item_food" for "item_food_{:03}"
+        auto literal = format.substr(0, format.find('{'));
+        while (literal.ends_with('_'))
+            literal.remove_suffix(1);
+        addWord(literal);
+    }
+}
+
+void HashCracker::search(ThreadPool& pool,
+                         const std::vector<std::string>& prefixes,
+                         const std::vector<std::string>& suffixes,
+                         std::map<uint32_t, std::set<std::string>>& hits) const
+{
+    std::vector<std::string_view> views(prefixes.begin(), prefixes.end());
+    std::vector<uint32_t> states(prefixes.size());
+    makeHashes(views, states);
+
+    std::mutex hitMutex;
+
+    for (std::size_t begin = 0; begin < suffixes.size(); begin += SUFFIXES)
+    {
+        pool.submit(
+            [&, begin]
+            {
+                std::vector<std::pair<uint32_t, std::string>> found;
+                uint32_t out[BLOCK];
+
+                auto end = std::min(suffixes.size(), begin + SUFFIXES);
+                for (std::size_t block = 0; block < states.size(); block += BLOCK)
+                {
+                    auto count = std::min(BLOCK, states.size() - block);
+
+                    for (auto s = begin; s < end; s++)
+                    {
+                        extendHashes(std::span(states).subspan(block, count), out, suffixes[s]);
+
+                        for (std::size_t i = 0; i < count; i++)
+                            if (isTarget(out[i])) found.emplace_back(out[i], prefixes[block + i] + suffixes[s]);
+                    }
+                }
+
+                if (found.empty()) return;
+
+                std::lock_guard lock(hitMutex);
+                for (auto& [hash, name] : found)
+                    hits[hash].insert(std::move(name));
+            });
+    }
+
+    pool.wait();
+}
+
+uint64_t HashCracker::getCandidateCount(const CrackSettings& settings) const
+{
+    uint64_t wordCount = words.size();
+    uint64_t perSep    = 2 * wordCount * getDigitCount(settings.maxDigits);
+    if (settings.combineWords) perSep += wordCount * wordCount;
+
+    return wordCount + std::size(SEPARATORS) * perSep;
+}
+
+double HashCracker::getFalsePositiveRate(const CrackSettings& settings) const
+{
+    // every candidate hits a given 32 bit hash with a chance of 1 in 2^32
+    return static_cast<double>(getCandidateCount(settings)) / 4294967296.0;
+}
+
+std::map<uint32_t, std::set<std::string>> HashCracker::run(ThreadPool& pool, const CrackSettings& settings) const
+{
+    if (settings.maxDigits > CrackSettings::MAX_DIGITS)
+        throw std::invalid_argument(
+            std::format("Can't try {} digits, at most {} are supported.", settings.maxDigits, CrackSettings::MAX_DIGITS));
+    if (settings.combineWords && words.size() > settings.maxCombinedWords)
+        throw std::invalid_argument(std::format("Can't combine {} words, at most {} words can be combined.",
+                                                words.size(),
+                                                settings.maxCombinedWords));
+
+    std::map<uint32_t, std::set<std::string>> hits;
+
+    std::vector<std::string> wordList(words.begin(), words.end());
+    auto digits = makeDigits(settings.maxDigits);
+
+    // plain words
+    std::vector<std::string_view> wordViews(wordList.begin(), wordList.end());
+    std::vector<uint32_t> wordHashes(wordList.size());
+    makeHashes(wordViews, wordHashes);
+    for (std::size_t i = 0; i < wordList.size(); i++)
+        if (isTarget(wordHashes[i])) hits[wordHashes[i]].insert(wordList[i]);
+
+    for (auto separator : SEPARATORS)
+    {
+        std::vector<std::string> wordPrefixes;
+        std::vector<std::string> digitPrefixes;
+        for (auto& word : wordList)
+            wordPrefixes.push_back(word + separator);
+        for (auto& digit : digits)
+            digitPrefixes.push_back(digit + separator);
+
+        search(pool, wordPrefixes, digits, hits);
+        search(pool, digitPrefixes, wordList, hits);
+        if (settings.combineWords) search(pool, wordPrefixes, wordList, hits);
+    }
+
+    return hits;
+}
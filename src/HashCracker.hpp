@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <set>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+class ThreadPool;
+
+struct CrackSettings
+{
+    static constexpr uint32_t MAX_DIGITS = 6; // every digit multiplies the candidates by 10
+
+    uint32_t maxDigits           = 3;     // longest digit run tried in front of or after a word
+    bool combineWords            = false; // try every pair of words
+    std::size_t maxCombinedWords = 2000;  // combining more words gives too many collisions to be useful
+};
+
+/*
+ * Brute force search for names of unresolved hashes.
+ * Candidates are built from a word list as "<word><sep><digits>", "<digits><sep><word>" and, if enabled,
+ * "<word><sep><word>", with sep being either nothing or '_'. The hash state of every prefix is computed once,
+ * blocks of prefixes are then extended by the same suffix side by side in SIMD lanes, see extendHashes.
+ */
+class HashCracker
+{
+    std::unordered_set<uint32_t> targets;
+    std::vector<uint64_t> filter; // bitmap over the low bits of the targets, rejects most candidates early
+    std::set<std::string> words;
+
+private:
+    bool isTarget(uint32_t hash) const;
+    void search(ThreadPool& pool,
+                const std::vector<std::string>& prefixes,
+                const std::vector<std::string>& suffixes,
+                std::map<uint32_t, std::set<std::string>>& hits) const;
+
+public:
+    HashCracker();
+
+    void addTarget(uint32_t hash);
+    // adds the word, its leading parts and its parts split at '_' and digits, each with lower and upper case variants
+    void addWord(std::string_view word);
+    // collects every hash the RainbowTable can't resolve as target and every string as word
+    void addFile(const std::filesystem::path& path);
+    // adds the words of every dictionary entry, the literal parts of patterns included
+    void addDictionary();
+
+    std::size_t getTargetCount() const { return targets.size(); }
+    std::size_t getWordCount() const { return words.size(); }
+    // number of names run() tries with the settings
+    uint64_t getCandidateCount(const CrackSettings& settings) const;
+    // matches a target gets by chance alone, on average, the share of false positives among single hits
+    double getFalsePositiveRate(const CrackSettings& settings) const;
+
+    // all candidate names found per hash, more than one name for a hash means at least one is a collision
+    // throws std::invalid_argument if maxDigits exceeds MAX_DIGITS, or if words should be combined but there are
+    // more than maxCombinedWords
+    std::map<uint32_t, std::set<std::string>> run(ThreadPool& pool, const CrackSettings& settings) const;
+};
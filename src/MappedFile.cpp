@@ -0,0 +1,101 @@
+#include "MappedFile.hpp"
+#include "Profiler.hpp"
+
+#include <format>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#    define WIN32_LEAN_AND_MEAN
+#    define NOMINMAX
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <unistd.h>
+#endif
+
+MappedFile::MappedFile(const std::filesystem::path& path)
+{
+    PROFILE_SCOPE("map file");
+
+    const auto fileSize = std::filesystem::file_size(path);
+    PROFILE_COUNT("bytes mapped", fileSize);
+    if (fileSize == 0) return;
+
+#ifdef _WIN32
+    fileHandle = CreateFileW(path.c_str(),
+                             GENERIC_READ,
+                             FILE_SHARE_READ,
+                             nullptr,
+                             OPEN_EXISTING,
+                             FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN,
+                             nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+    {
+        fileHandle = nullptr;
+        throw std::runtime_error(std::format("Failed to open {}", path.string()));
+    }
+
+    mappingHandle = CreateFileMappingW(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mappingHandle == nullptr)
+    {
+        close();
+        throw std::runtime_error(std::format("Failed to map {}", path.string()));
+    }
+
+    ptr = static_cast<const char*>(MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    if (ptr == nullptr)
+    {
+        close();
+        throw std::runtime_error(std::format("Failed to map {}", path.string()));
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) throw std::runtime_error(std::format("Failed to open {}", path.string()));
+
+    void* mapped = mmap(nullptr, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (mapped == MAP_FAILED) throw std::runtime_error(std::format("Failed to map {}", path.string()));
+
+    ptr = static_cast<const char*>(mapped);
+    madvise(mapped, fileSize, MADV_SEQUENTIAL);
+#endif
+
+    length = fileSize;
+}
+
+MappedFile::~MappedFile() { close(); }
+
+MappedFile::MappedFile(MappedFile&& other) noexcept { *this = std::move(other); }
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+    if (this == &other) return *this;
+
+    close();
+    ptr    = std::exchange(other.ptr, nullptr);
+    length = std::exchange(other.length, 0);
+#ifdef _WIN32
+    fileHandle    = std::exchange(other.fileHandle, nullptr);
+    mappingHandle = std::exchange(other.mappingHandle, nullptr);
+#endif
+
+    return *this;
+}
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if (ptr) UnmapViewOfFile(ptr);
+    if (mappingHandle) CloseHandle(mappingHandle);
+    if (fileHandle) CloseHandle(fileHandle);
+    mappingHandle = nullptr;
+    fileHandle    = nullptr;
+#else
+    if (ptr) munmap(const_cast<char*>(ptr), length);
+#endif
+    ptr    = nullptr;
+    length = 0;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <filesystem>
+#include <span>
+
+/*
+ * Read-only memory mapping of a whole file.
+ * The mapping stays valid for the lifetime of the object, an empty file maps to an empty span.
+ */
+class MappedFile
+{
+    const char* ptr    = nullptr;
+    std::size_t length = 0;
+#ifdef _WIN32
+    void* fileHandle    = nullptr;
+    void* mappingHandle = nullptr;
+#endif
+
+private:
+    void close();
+
+public:
+    MappedFile() = default;
+    explicit MappedFile(const std::filesystem::path& path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&)            = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    std::span<const char> data() const { return { ptr, length }; }
+    std::size_t size() const { return length; }
+};
@@ -0,0 +1,246 @@
+#include "PackManifest.hpp"
+#include "CSVB.hpp"
+#include "MappedFile.hpp"
+#include "Profiler.hpp"
+#include "StructureRegistry.hpp"
+#include "utils.hpp"
+
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <stdexcept>
+
+namespace
+{
+    constexpr uint32_t MANIFEST_MAGIC   = 'PKMF';
+    constexpr uint32_t MANIFEST_VERSION = 2;
+    // bump whenever the packer's output for the same input changes, so existing manifests are ignored
+    constexpr uint32_t ENCODER_VERSION = 5;
+
+    class ManifestWriter
+    {
+        std::string buffer;
+
+    public:
+        template<typename T>
+        void put(const T& value)
+        {
+            buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        void put(std::string_view value)
+        {
+            put(static_cast<uint64_t>(value.size()));
+            buffer.append(value);
+        }
+
+        void put(const FileStamp& stamp)
+        {
+            put(stamp.size);
+            put(stamp.time);
+            put(stamp.hash);
+        }
+
+        const std::string& data() const { return buffer; }
+    };
+
+    class ManifestReader
+    {
+        std::span<const char> data;
+        std::size_t pos = 0;
+
+    public:
+        ManifestReader(std::span<const char> data)
+            : data(data)
+        {
+        }
+
+        std::string_view bytes(uint64_t count)
+        {
+            if (count > data.size() - pos) throw std::runtime_error("Truncated manifest.");
+            std::string_view value(data.data() + pos, count);
+            pos += count;
+            return value;
+        }
+
+        template<typename T>
+        T get()
+        {
+            T value;
+            std::memcpy(&value, bytes(sizeof(T)).data(), sizeof(T));
+            return value;
+        }
+
+        std::string_view string() { return bytes(get<uint64_t>()); }
+
+        FileStamp stamp()
+        {
+            FileStamp stamp;
+            stamp.size = get<uint64_t>();
+            stamp.time = get<int64_t>();
+            stamp.hash = get<uint64_t>();
+            return stamp;
+        }
+
+        bool atEnd() const { return pos == data.size(); }
+    };
+} // namespace
+
+FileStamp FileStamp::of(const std::filesystem::path& path)
+{
+    FileStamp stamp;
+
+    std::error_code error;
+    auto size = std::filesystem::file_size(path, error);
+    if (error) return stamp;
+    auto time = std::filesystem::last_write_time(path, error);
+    if (error) return stamp;
+
+    stamp.size = size;
+    stamp.time = static_cast<int64_t>(time.time_since_epoch().count());
+    return stamp;
+}
+
+const TableSnapshot* PackManifest::findTable(std::string_view name) const
+{
+    for (auto& table : tables)
+        if (table.name == name) return &table;
+    return nullptr;
+}
+
+std::filesystem::path PackManifest::getPath(const std::filesystem::path& output)
+{
+    auto key = std::filesystem::absolute(output).lexically_normal().string();
+    return getStructuresPath() / "cache" / std::format("{:016x}.manifest", makeHash64(key));
+}
+
+std::optional<PackManifest> PackManifest::load(const std::filesystem::path& path)
+{
+    if (!std::filesystem::is_regular_file(path)) return std::nullopt;
+
+    // the manifest is only a cache, anything unexpected just means a full rebuild
+    try
+    {
+        MappedFile file(path);
+        ManifestReader reader(file.data());
+
+        if (reader.get<uint32_t>() != MANIFEST_MAGIC || reader.get<uint32_t>() != MANIFEST_VERSION)
+            return std::nullopt;
+
+        PackManifest manifest;
+        manifest.encoderVersion       = reader.get<uint32_t>();
+        manifest.mergeStrings         = reader.get<uint32_t>() != 0;
+        manifest.structureFingerprint = reader.get<uint64_t>();
+        manifest.output               = reader.stamp();
+        manifest.variableData         = reader.stamp();
+
+        auto tableCount = reader.get<uint32_t>();
+        for (uint32_t i = 0; i < tableCount; i++)
+        {
+            TableSnapshot table;
+            table.name       = reader.string();
+            table.csv        = reader.stamp();
+            table.entryCount = reader.get<uint32_t>();
+
+            auto rows = reader.string();
+            table.data.assign(rows.begin(), rows.end());
+
+            auto stringCount = reader.get<uint32_t>();
+            for (uint32_t j = 0; j < stringCount; j++)
+                table.strings.emplace_back(reader.string());
+
+            manifest.tables.push_back(std::move(table));
+        }
+
+        if (!reader.atEnd()) return std::nullopt;
+        return manifest;
+    }
+    catch (std::exception&)
+    {
+        return std::nullopt;
+    }
+}
+
+void PackManifest::save(const std::filesystem::path& path) const
+{
+    ManifestWriter writer;
+    writer.put(MANIFEST_MAGIC);
+    writer.put(MANIFEST_VERSION);
+    writer.put(encoderVersion);
+    writer.put(static_cast<uint32_t>(mergeStrings));
+    writer.put(structureFingerprint);
+    writer.put(output);
+    writer.put(variableData);
+
+    writer.put(static_cast<uint32_t>(tables.size()));
+    for (auto& table : tables)
+    {
+        writer.put(std::string_view(table.name));
+        writer.put(table.csv);
+        writer.put(table.entryCount);
+        writer.put(std::string_view(reinterpret_cast<const char*>(table.data.data()), table.data.size()));
+
+        writer.put(static_cast<uint32_t>(table.strings.size()));
+        for (auto& string : table.strings)
+            writer.put(std::string_view(string));
+    }
+
+    // a failed write only costs a full rebuild next time
+    std::error_code error;
+    std::filesystem::create_directories(path.parent_path(), error);
+    if (error) return;
+
+    auto tempPath = getTempPath(path);
+    {
+        std::ofstream file(tempPath, std::ios::out | std::ios::binary);
+        if (!file) return;
+
+        file.write(writer.data().data(), writer.data().size());
+        if (!file) return;
+    }
+
+    std::filesystem::rename(tempPath, path, error);
+    if (error) std::filesystem::remove(tempPath, error);
+}
+
+bool packIncremental(const std::filesystem::path& input, const std::filesystem::path& output, bool mergeStrings)
+{
+    PROFILE_SCOPE("pack incremental");
+
+    auto structure = StructureRegistry::find(input, true);
+    if (!structure) throw std::runtime_error("No structure found. Aborting.");
+
+    auto manifestPath = PackManifest::getPath(output);
+    auto previous     = PackManifest::load(manifestPath);
+
+    if (!previous || previous->encoderVersion != ENCODER_VERSION || previous->mergeStrings != mergeStrings ||
+        previous->structureFingerprint != structure->fingerprint)
+        previous = PackManifest{};
+
+    // quick check of size and modification time of every input and the output
+    auto variablePath = input / CSVBExporter::VARIABLE_DATA_FILE;
+    bool upToDate     = previous->output.sameFile(FileStamp::of(output)) && previous->output.size != 0 &&
+                    previous->variableData.sameFile(FileStamp::of(variablePath)) &&
+                    previous->tables.size() == structure->tables.size();
+    for (std::size_t i = 0; upToDate && i < structure->tables.size(); i++)
+    {
+        auto& name  = structure->tables[i].name;
+        auto& table = previous->tables[i];
+        upToDate    = table.name == name && table.csv.sameFile(FileStamp::of(CSVBImporter::getTablePath(input, name)));
+    }
+    if (upToDate) return false;
+
+    CSVBImporter importer(input, mergeStrings, &*previous);
+    importer.write(output);
+
+    PackManifest manifest;
+    manifest.encoderVersion       = ENCODER_VERSION;
+    manifest.mergeStrings         = mergeStrings;
+    manifest.structureFingerprint = structure->fingerprint;
+    manifest.output               = FileStamp::of(output);
+    manifest.variableData         = FileStamp::of(variablePath);
+    manifest.tables               = std::move(importer.getSnapshots());
+    manifest.save(manifestPath);
+
+    return true;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// identifies a file version, size and modification time are a quick check in front of the content hash
+struct FileStamp
+{
+    uint64_t size = 0;
+    int64_t time  = 0;
+    uint64_t hash = 0;
+
+    // size and time of the file, all zero if it doesn't exist
+    static FileStamp of(const std::filesystem::path& path);
+
+    bool sameFile(const FileStamp& other) const { return size == other.size && time == other.time; }
+};
+
+// encoded rows of a table, vstring fields hold indices into strings instead of string offsets
+struct TableSnapshot
+{
+    std::string name;
+    FileStamp csv; // the CSV or columnar file the rows were read from
+    uint32_t entryCount = 0;
+    std::vector<uint8_t> data;
+    std::vector<std::string> strings; // in order of first use
+};
+
+/*
+ * State of the last incremental pack into an output file.
+ * Kept in structures/cache, keyed by the output path. A folder is packed again once a CSV, its structure, the
+ * options or the packer changed, or once the output was touched. Tables whose CSV didn't change are restored
+ * from their snapshot instead of being parsed.
+ */
+class PackManifest
+{
+public:
+    uint32_t encoderVersion       = 0;
+    uint64_t structureFingerprint = 0;
+    bool mergeStrings             = false;
+    FileStamp output;
+    FileStamp variableData; // extracted variable data sections, copied as they are
+    std::vector<TableSnapshot> tables;
+
+public:
+    const TableSnapshot* findTable(std::string_view name) const;
+
+    static std::optional<PackManifest> load(const std::filesystem::path& path);
+    void save(const std::filesystem::path& path) const;
+
+    static std::filesystem::path getPath(const std::filesystem::path& output);
+};
+
+// packs input into output unless nothing changed since the last incremental pack, returns whether it packed
+bool packIncremental(const std::filesystem::path& input, const std::filesystem::path& output, bool mergeStrings);
@@ -0,0 +1,219 @@
+#include "Profiler.hpp"
+
+#include <boost/json.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    const Clock::time_point EPOCH = Clock::now();
+
+    std::atomic<bool> tracing              = false;
+    std::atomic<uint64_t> allocationCount = 0;
+    std::atomic<uint64_t> allocationBytes = 0;
+
+    struct Timer
+    {
+        uint64_t calls       = 0;
+        int64_t nanoseconds  = 0;
+        uint64_t allocations = 0;
+    };
+
+    struct Event
+    {
+        const char* name;
+        int64_t start;
+        int64_t duration;
+    };
+
+    struct ThreadData
+    {
+        uint32_t id;
+        std::mutex mutex; // only contended while a report is made
+        std::unordered_map<const char*, Timer> timers;
+        std::map<std::string, uint64_t, std::less<>> counters;
+        std::vector<Event> events;
+    };
+
+    std::mutex threadsMutex;
+    std::vector<std::shared_ptr<ThreadData>> threads;
+
+    ThreadData& getThreadData()
+    {
+        thread_local std::shared_ptr<ThreadData> data = []
+        {
+            auto data = std::make_shared<ThreadData>();
+
+            std::lock_guard lock(threadsMutex);
+            data->id = static_cast<uint32_t>(threads.size());
+            threads.push_back(data);
+            return data;
+        }();
+
+        return *data;
+    }
+
+    // timers and counters of all threads, by name
+    struct Totals
+    {
+        std::map<std::string, Timer> timers;
+        std::map<std::string, uint64_t> counters;
+    };
+
+    Totals collect()
+    {
+        Totals totals;
+
+        std::lock_guard lock(threadsMutex);
+        for (auto& thread : threads)
+        {
+            std::lock_guard threadLock(thread->mutex);
+            for (auto& [name, timer] : thread->timers)
+            {
+                auto& total = totals.timers[name];
+                total.calls += timer.calls;
+                total.nanoseconds += timer.nanoseconds;
+                total.allocations += timer.allocations;
+            }
+            for (auto& [name, value] : thread->counters)
+                totals.counters[name] += value;
+        }
+
+        return totals;
+    }
+} // namespace
+
+int64_t Profiler::now() { return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - EPOCH).count(); }
+
+void Profiler::enable(bool trace)
+{
+    tracing = tracing || trace;
+    enabled = true;
+}
+
+void Profiler::record(const char* name, int64_t start, uint64_t allocations)
+{
+    auto duration = now() - start;
+    auto& data    = getThreadData();
+
+    std::lock_guard lock(data.mutex);
+    auto& timer = data.timers[name];
+    timer.calls++;
+    timer.nanoseconds += duration;
+    timer.allocations += threadAllocations - allocations;
+
+    if (tracing.load(std::memory_order_relaxed)) data.events.push_back({ name, start, duration });
+}
+
+void Profiler::count(std::string_view name, uint64_t value)
+{
+    auto& data = getThreadData();
+
+    std::lock_guard lock(data.mutex);
+    auto itr = data.counters.find(name);
+    if (itr == data.counters.end()) itr = data.counters.emplace(name, 0).first;
+    itr->second += value;
+}
+
+void Profiler::countAllocation(std::size_t size)
+{
+    if (!isEnabled()) return;
+
+    threadAllocations++;
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    allocationBytes.fetch_add(size, std::memory_order_relaxed);
+}
+
+void Profiler::printSummary(std::ostream& output)
+{
+    auto totals = collect();
+
+    // slowest first, times of nested scopes are included in their parents
+    std::vector<std::pair<std::string, Timer>> timers(totals.timers.begin(), totals.timers.end());
+    std::stable_sort(timers.begin(),
+                     timers.end(),
+                     [](auto& lhs, auto& rhs) { return lhs.second.nanoseconds > rhs.second.nanoseconds; });
+
+    output << std::format("{:<32} {:>10} {:>12} {:>12} {:>12}\n", "Scope", "Calls", "Total ms", "Mean us", "Allocs");
+    for (auto& [name, timer] : timers)
+        output << std::format("{:<32} {:>10} {:>12.3f} {:>12.3f} {:>12}\n",
+                              name,
+                              timer.calls,
+                              timer.nanoseconds / 1e6,
+                              timer.nanoseconds / 1e3 / timer.calls,
+                              timer.allocations);
+
+    output << std::format("\n{:<48} {:>16}\n", "Counter", "Value");
+    for (auto& [name, value] : totals.counters)
+        output << std::format("{:<48} {:>16}\n", name, value);
+
+    auto hits   = totals.counters["rainbow table hits"];
+    auto misses = totals.counters["rainbow table misses"];
+    if (hits + misses != 0)
+        output << std::format("{:<48} {:>15.1f}%\n", "rainbow table hit rate", 100.0 * hits / (hits + misses));
+
+    output << std::format("{:<48} {:>16}\n", "allocations", allocationCount.load());
+    output << std::format("{:<48} {:>16}\n", "allocated bytes", allocationBytes.load());
+}
+
+void Profiler::writeTrace(const std::filesystem::path& path)
+{
+    boost::json::array events;
+    int64_t end = 0;
+
+    {
+        std::lock_guard lock(threadsMutex);
+        for (auto& thread : threads)
+        {
+            std::lock_guard threadLock(thread->mutex);
+            for (auto& event : thread->events)
+            {
+                boost::json::object entry;
+                entry["name"] = event.name;
+                entry["ph"]   = "X";
+                entry["ts"]   = event.start / 1e3;
+                entry["dur"]  = event.duration / 1e3;
+                entry["pid"]  = 1;
+                entry["tid"]  = thread->id;
+                events.push_back(entry);
+
+                end = std::max(end, event.start + event.duration);
+            }
+        }
+    }
+
+    // counters are only known as totals, they are shown at the end of the trace
+    for (auto& [name, value] : collect().counters)
+    {
+        boost::json::object args;
+        args["value"] = value;
+
+        boost::json::object entry;
+        entry["name"] = name;
+        entry["ph"]   = "C";
+        entry["ts"]   = end / 1e3;
+        entry["pid"]  = 1;
+        entry["args"] = args;
+        events.push_back(entry);
+    }
+
+    boost::json::object trace;
+    trace["traceEvents"]     = events;
+    trace["displayTimeUnit"] = "ms";
+
+    std::ofstream output(path);
+    output << boost::json::serialize(trace);
+    if (!output) throw std::runtime_error("Error: failed to write " + path.string());
+}
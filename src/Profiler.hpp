@@ -0,0 +1,79 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <ostream>
+#include <string_view>
+
+/*
+ * Scoped timers and counters behind --stats and --trace.
+ * Every thread records into buffers of its own, which are only merged for the report. Nothing is recorded until
+ * enable() is called, and without DWNO_PROFILING the macros below compile to nothing at all.
+ */
+class Profiler
+{
+    static inline std::atomic<bool> enabled = false;
+    static inline thread_local uint64_t threadAllocations = 0;
+
+private:
+    static int64_t now();
+    static void record(const char* name, int64_t start, uint64_t allocations);
+
+public:
+    // times the enclosing scope, nested scopes are included in the time of their parents
+    class Scope
+    {
+        const char* name     = nullptr;
+        int64_t start        = 0;
+        uint64_t allocations = 0;
+
+    public:
+        explicit Scope(const char* name)
+        {
+            if (!isEnabled()) return;
+
+            this->name  = name;
+            start       = now();
+            allocations = threadAllocations;
+        }
+        ~Scope()
+        {
+            if (name) record(name, start, allocations);
+        }
+
+        Scope(const Scope&)            = delete;
+        Scope& operator=(const Scope&) = delete;
+    };
+
+    // with trace every single scope is kept for writeTrace, otherwise only their totals
+    static void enable(bool trace);
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    static void count(std::string_view name, uint64_t value = 1);
+    // called for every operator new of the executable, must not allocate itself
+    static void countAllocation(std::size_t size);
+
+    // table of the scopes and counters recorded by all threads so far
+    static void printSummary(std::ostream& output);
+    // Chrome trace event JSON, for chrome://tracing or Perfetto
+    static void writeTrace(const std::filesystem::path& path);
+};
+
+#ifdef DWNO_PROFILING
+#    define DWNO_PROFILE_CONCAT_(a, b) a##b
+#    define DWNO_PROFILE_CONCAT(a, b)  DWNO_PROFILE_CONCAT_(a, b)
+#    define PROFILE_SCOPE(name)        Profiler::Scope DWNO_PROFILE_CONCAT(profileScope, __LINE__)(name)
+// the arguments are only evaluated while profiling
+#    define PROFILE_COUNT(name, value)                                                                                 \
+        do                                                                                                             \
+        {                                                                                                              \
+            if (Profiler::isEnabled()) Profiler::count(name, value);                                                   \
+        } while (false)
+#else
+#    define PROFILE_SCOPE(name)
+#    define PROFILE_COUNT(name, value)                                                                                 \
+        do                                                                                                             \
+        {                                                                                                              \
+        } while (false)
+#endif
@@ -0,0 +1,193 @@
+#include "RainbowTable.hpp"
+#include "Dictionary.hpp"
+#include "Profiler.hpp"
+#include "ThreadPool.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <fstream>
+
+namespace
+{
+    struct IndexHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t fingerprint;
+        uint32_t entryCount;
+        uint32_t poolSize;
+    };
+
+    constexpr uint32_t INDEX_MAGIC   = 'RBWT';
+    constexpr uint32_t INDEX_VERSION = 2;
+} // namespace
+
+RainbowTable& RainbowTable::getInstance()
+{
+    static RainbowTable instance;
+    return instance;
+}
+
+std::filesystem::path RainbowTable::getIndexPath() { return getStructuresPath() / "rainbow.bin"; }
+
+RainbowTable::RainbowTable()
+{
+    PROFILE_SCOPE("load rainbow table");
+
+    Dictionary dictionary(Dictionary::getDictionaryPath());
+    auto fingerprint = dictionary.getFingerprint();
+    auto path        = getIndexPath();
+
+    if (load(path, fingerprint)) return;
+
+    build(dictionary);
+    save(path, fingerprint);
+}
+
+bool RainbowTable::load(const std::filesystem::path& path, uint64_t fingerprint)
+{
+    if (!std::filesystem::is_regular_file(path)) return false;
+
+    try
+    {
+        MappedFile file(path);
+        auto data = file.data();
+
+        IndexHeader header;
+        if (data.size() < sizeof(header)) return false;
+        std::memcpy(&header, data.data(), sizeof(header));
+
+        if (header.magic != INDEX_MAGIC || header.version != INDEX_VERSION || header.fingerprint != fingerprint)
+            return false;
+        if (sizeof(header) + static_cast<uint64_t>(header.entryCount) * sizeof(Entry) + header.poolSize != data.size())
+            return false;
+
+        entries   = { reinterpret_cast<const Entry*>(data.data() + sizeof(header)), header.entryCount };
+        pool      = { data.data() + sizeof(header) + header.entryCount * sizeof(Entry), header.poolSize };
+        indexFile = std::move(file);
+    }
+    catch (std::exception&)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+void RainbowTable::build(const Dictionary& dictionary)
+{
+    std::vector<Entry> candidates;
+    candidates.push_back({ makeHash(""), 0, 0 });
+
+    ThreadPool threadPool;
+    dictionary.expand(threadPool, candidates, ownedPool);
+
+    // keep the shortest name per hash, the first one wins a tie
+    std::stable_sort(candidates.begin(),
+                     candidates.end(),
+                     [](const Entry& a, const Entry& b) { return a.hash < b.hash; });
+
+    for (auto& candidate : candidates)
+    {
+        if (!ownedEntries.empty() && ownedEntries.back().hash == candidate.hash)
+        {
+            if (ownedEntries.back().length > candidate.length) ownedEntries.back() = candidate;
+            continue;
+        }
+        ownedEntries.push_back(candidate);
+    }
+
+    entries = ownedEntries;
+    pool    = ownedPool;
+}
+
+void RainbowTable::save(const std::filesystem::path& path, uint64_t fingerprint)
+{
+    IndexHeader header{ INDEX_MAGIC,
+                        INDEX_VERSION,
+                        fingerprint,
+                        static_cast<uint32_t>(entries.size()),
+                        static_cast<uint32_t>(pool.size()) };
+
+    // the index is only a cache, failing to write it is fine
+    std::error_code error;
+    if (!std::filesystem::is_directory(path.parent_path(), error)) return;
+
+    auto tempPath = getTempPath(path);
+    {
+        std::ofstream output(tempPath, std::ios::out | std::ios::binary);
+        if (!output) return;
+
+        output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        output.write(reinterpret_cast<const char*>(entries.data()), entries.size_bytes());
+        output.write(pool.data(), pool.size());
+        if (!output) return;
+    }
+
+    std::filesystem::rename(tempPath, path, error);
+    if (error) std::filesystem::remove(tempPath, error);
+}
+
+std::optional<std::string_view> RainbowTable::lookup(uint32_t hash)
+{
+    std::optional<std::string_view> result;
+
+    auto itr = std::lower_bound(entries.begin(),
+                                entries.end(),
+                                hash,
+                                [](const Entry& entry, uint32_t value) { return entry.hash < value; });
+    if (itr != entries.end() && itr->hash == hash) result = pool.substr(itr->offset, itr->length);
+
+    std::shared_lock lock(addedMutex);
+    auto addedItr = added.find(hash);
+    if (addedItr != added.end() && (!result || result->length() > addedItr->second.length()))
+        result = addedItr->second;
+
+    return result;
+}
+
+void RainbowTable::_addHash(std::string_view input)
+{
+    auto hash     = makeHash(input);
+    auto existing = lookup(hash);
+    if (existing && existing->length() <= input.length()) return;
+
+    std::unique_lock lock(addedMutex);
+    auto itr = added.find(hash);
+    if (itr != added.end() && itr->second.length() <= input.length()) return;
+
+    added[hash] = addedStrings.emplace_back(input);
+}
+
+std::optional<std::string_view> RainbowTable::_reverseHash(uint32_t input)
+{
+    auto result = lookup(input);
+    PROFILE_COUNT(result ? "rainbow table hits" : "rainbow table misses", 1);
+    if (!result) return {};
+
+    std::lock_guard lock(usedMutex);
+    usedHashes.insert(input);
+    return result;
+}
+
+boost::json::object RainbowTable::_toJSON()
+{
+    boost::json::object obj;
+
+    std::vector<std::pair<std::string, std::string>> vec;
+
+    {
+        std::lock_guard lock(usedMutex);
+        for (auto val : usedHashes)
+            vec.emplace_back(*lookup(val), std::format("{:x}", val));
+    }
+
+    std::sort(vec.begin(), vec.end());
+
+    for (auto val : vec)
+        obj[val.first] = val.second;
+
+    return obj;
+}
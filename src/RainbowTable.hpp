@@ -0,0 +1,69 @@
+#pragma once
+
+#include "Dictionary.hpp"
+#include "MappedFile.hpp"
+
+#include <boost/json.hpp>
+
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <set>
+#include <shared_mutex>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+/*
+ * Reverse lookup of known hashes.
+ * The names of the Dictionary are kept as one hash sorted index into a single string pool. It's built on first use
+ * and cached in an index file next to the structures, so later runs only have to map that file as long as the
+ * dictionary didn't change. Names added at runtime go into a small overlay.
+ */
+class RainbowTable
+{
+public:
+    using Entry = Dictionary::Name;
+
+private:
+    MappedFile indexFile;
+    std::vector<Entry> ownedEntries;
+    std::string ownedPool;
+    std::span<const Entry> entries;
+    std::string_view pool;
+
+    // exports may run concurrently, see ThreadPool
+    std::shared_mutex addedMutex;
+    std::unordered_map<uint32_t, std::string_view> added;
+    std::deque<std::string> addedStrings;
+
+    std::mutex usedMutex;
+    std::set<uint32_t> usedHashes;
+
+private:
+    RainbowTable();
+    RainbowTable(RainbowTable& copy) = delete;
+
+    bool load(const std::filesystem::path& path, uint64_t fingerprint);
+    void build(const Dictionary& dictionary);
+    void save(const std::filesystem::path& path, uint64_t fingerprint);
+    std::optional<std::string_view> lookup(uint32_t hash);
+
+public:
+    void _addHash(std::string_view input);
+    bool _hasHash(uint32_t input) { return lookup(input).has_value(); }
+    std::optional<std::string_view> _reverseHash(uint32_t input);
+    boost::json::object _toJSON();
+
+public:
+    static RainbowTable& getInstance();
+    static std::filesystem::path getIndexPath();
+    static void addHash(std::string_view input) { getInstance()._addHash(input); }
+    static bool hasHash(uint32_t input) { return getInstance()._hasHash(input); }
+    static std::optional<std::string_view> reverseHash(uint32_t input) { return getInstance()._reverseHash(input); }
+    static boost::json::object toJSON() { return getInstance()._toJSON(); }
+};
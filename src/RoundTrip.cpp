@@ -0,0 +1,141 @@
+#include "RoundTrip.hpp"
+#include "CSVB.hpp"
+#include "CSVWriter.hpp"
+#include "Profiler.hpp"
+#include "StructureRegistry.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <vector>
+
+namespace
+{
+    std::string formatBytes(std::span<const std::byte> data, std::size_t offset, std::size_t size)
+    {
+        if (offset + size > data.size()) return "missing";
+
+        std::string text;
+        for (std::size_t i = 0; i < size; i++)
+            text += std::format("{}{:02x}", i == 0 ? "" : " ", static_cast<uint8_t>(data[offset + i]));
+        return text;
+    }
+
+    std::string describeOffset(CSVBExporter& exporter,
+                               std::span<const std::byte> original,
+                               std::span<const std::byte> repacked,
+                               std::size_t offset)
+    {
+        auto& view   = exporter.getView();
+        auto& header = view.getHeader();
+
+        if (offset >= std::min(original.size(), repacked.size()))
+            return std::format("end of file, {} bytes were packed into {}", original.size(), repacked.size());
+        if (offset < sizeof(CSVBHeader)) return "header";
+        if (offset < sizeof(CSVBHeader) + view.tableCount() * sizeof(CSVBTable))
+        {
+            auto table = (offset - sizeof(CSVBHeader)) / sizeof(CSVBTable);
+            return std::format("table list entry of {}", view.table(table).name());
+        }
+
+        for (std::size_t t = 0; t < view.tableCount(); t++)
+        {
+            auto table = view.table(t);
+            auto begin = table.raw().dataOffset;
+            if (offset < begin || offset >= begin + static_cast<uint64_t>(table.entrySize()) * table.entryCount())
+                continue;
+
+            auto row      = static_cast<uint32_t>((offset - begin) / table.entrySize());
+            auto position = (offset - begin) % table.entrySize();
+            RowCodec codec(table.types());
+            for (std::size_t i = 0; i < codec.fieldCount(); i++)
+            {
+                auto& field = codec[i];
+                if (position < field.offset || position >= field.offset + field.size) continue;
+
+                auto fieldStart = offset - position + field.offset;
+                return std::format("{} row {} column {} ({}), {} became {}",
+                                   table.name(),
+                                   row,
+                                   exporter.getColumnNames(t)[i],
+                                   getTypeKey(field.type),
+                                   formatBytes(original, fieldStart, field.size),
+                                   formatBytes(repacked, fieldStart, field.size));
+            }
+            return std::format("{} row {}, behind its fields", table.name(), row);
+        }
+
+        // the variable data sections follow the string section up to the end of the file
+        const auto stringEnd = original.size() - view.variableData().size();
+        if (offset >= header.structureOffset && offset < header.stringOffset) return "structure section";
+        if (offset >= header.stringOffset && offset < stringEnd)
+        {
+            // the string the byte belongs to, found by going back to the end of the previous one
+            auto start = offset;
+            while (start > header.stringOffset && original[start - 1] != std::byte(0))
+                start--;
+
+            auto string = view.string(static_cast<uint32_t>(start - header.stringOffset));
+            return std::format("string section, in \"{}\"", string);
+        }
+        if (view.hasVariableData()) return "variable data";
+        return "padding";
+    }
+} // namespace
+
+std::optional<RoundTripResult> verifyRoundTrip(std::span<const std::byte> data,
+                                               const std::filesystem::path& source,
+                                               bool columnar)
+{
+    PROFILE_SCOPE("verify file");
+
+    CSVBExporter exporter(data, source);
+    if (!exporter.isValid()) return std::nullopt;
+
+    auto& view = exporter.getView();
+
+    // CSV text or columnar table of every table, alive until the importer is done
+    std::vector<std::vector<char>> tables(view.tableCount());
+    CSVBImporter::TableSources sources;
+    for (std::size_t t = 0; t < view.tableCount(); t++)
+    {
+        if (columnar)
+            tables[t] = exporter.encodeColumnar(t);
+        else
+        {
+            CSVWriter writer;
+            exporter.writeTable(t, writer);
+            auto text = writer.release();
+            tables[t].assign(text.begin(), text.end());
+        }
+        sources[view.table(t).name()] = std::as_bytes(std::span(tables[t]));
+    }
+
+    std::vector<char> variable;
+    if (view.hasVariableData())
+    {
+        auto header   = exporter.getVariableDataHeader();
+        auto sections = view.variableData();
+        variable.resize(sizeof(header) + sections.size());
+        std::memcpy(variable.data(), &header, sizeof(header));
+        std::memcpy(variable.data() + sizeof(header), sections.data(), sections.size());
+    }
+
+    auto structure = StructureRegistry::parse(exporter.getStructure());
+    CSVBImporter importer(structure, sources, std::as_bytes(std::span(variable)));
+
+    std::vector<std::byte> repacked(importer.packedSize());
+    importer.writeTo(repacked);
+
+    RoundTripResult result;
+    result.originalSize = data.size();
+    result.repackedSize = repacked.size();
+
+    auto [lhs, rhs] = std::mismatch(data.begin(), data.end(), repacked.begin(), repacked.end());
+    if (lhs == data.end() && rhs == repacked.end()) return result;
+
+    result.identical = false;
+    result.offset    = static_cast<std::size_t>(lhs - data.begin());
+    result.location  = describeOffset(exporter, data, repacked, result.offset);
+    return result;
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <span>
+#include <string>
+
+struct RoundTripResult
+{
+    bool identical           = true;
+    std::size_t originalSize = 0;
+    std::size_t repackedSize = 0;
+    std::size_t offset       = 0; // first byte that differs
+    std::string location;         // section, table, row and field of offset
+};
+
+/*
+ * Extracts a CSVB file in memory and packs it again, like -x followed by -p without touching the disk.
+ * source selects the structure like for CSVBExporter, with columnar the tables go through ColumnarTable instead of
+ * CSV. Returns nothing if the data isn't a CSVB file, conversion errors are thrown.
+ */
+std::optional<RoundTripResult> verifyRoundTrip(std::span<const std::byte> data,
+                                               const std::filesystem::path& source,
+                                               bool columnar = false);
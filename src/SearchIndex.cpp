@@ -0,0 +1,414 @@
+#include "SearchIndex.hpp"
+#include "CSVB.hpp"
+#include "Profiler.hpp"
+#include "StructureRegistry.hpp"
+#include "ThreadPool.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <limits>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+
+namespace
+{
+    constexpr uint32_t INDEX_MAGIC   = 'XDNI'; // "INDX" in the file
+    constexpr uint32_t INDEX_VERSION = 1;
+
+    class IndexWriter
+    {
+        std::vector<char> buffer;
+
+    public:
+        template<typename T>
+        void put(const T& value)
+        {
+            auto* ptr = reinterpret_cast<const char*>(&value);
+            buffer.insert(buffer.end(), ptr, ptr + sizeof(T));
+        }
+
+        void put(std::string_view value)
+        {
+            put(static_cast<uint32_t>(value.size()));
+            buffer.insert(buffer.end(), value.begin(), value.end());
+        }
+
+        // entries are 8 byte aligned, so they can be used straight from the mapped file
+        void put(std::span<const IndexEntry> entries)
+        {
+            put(static_cast<uint64_t>(entries.size()));
+            buffer.resize((buffer.size() + 7) & ~std::size_t(7));
+
+            auto* ptr = reinterpret_cast<const char*>(entries.data());
+            buffer.insert(buffer.end(), ptr, ptr + entries.size_bytes());
+        }
+
+        const std::vector<char>& data() const { return buffer; }
+    };
+
+    class IndexReader
+    {
+        std::span<const char> data;
+        std::size_t pos = 0;
+
+    public:
+        IndexReader(std::span<const char> data)
+            : data(data)
+        {
+        }
+
+        std::string_view bytes(uint64_t count)
+        {
+            if (count > data.size() - pos) throw std::runtime_error("Truncated index.");
+            std::string_view value(data.data() + pos, count);
+            pos += count;
+            return value;
+        }
+
+        template<typename T>
+        T get()
+        {
+            T value;
+            std::memcpy(&value, bytes(sizeof(T)).data(), sizeof(T));
+            return value;
+        }
+
+        std::string_view string() { return bytes(get<uint32_t>()); }
+
+        // number of elements that take at least minSize bytes each, checked before anything is allocated for them
+        uint32_t count(std::size_t minSize)
+        {
+            auto value = get<uint32_t>();
+            if (value > (data.size() - pos) / minSize) throw std::runtime_error("Truncated index.");
+            return value;
+        }
+
+        std::span<const IndexEntry> entries()
+        {
+            auto count = get<uint64_t>();
+            bytes(((pos + 7) & ~std::size_t(7)) - pos);
+            if (count > (data.size() - pos) / sizeof(IndexEntry)) throw std::runtime_error("Truncated index.");
+
+            auto* ptr = reinterpret_cast<const IndexEntry*>(bytes(count * sizeof(IndexEntry)).data());
+            return { ptr, count };
+        }
+
+        bool atEnd() const { return pos == data.size(); }
+    };
+
+    // the text of an inline string ends at its first NUL
+    std::string_view getInlineString(const char* data, uint32_t size)
+    {
+        return { data, strnlen(data, size) };
+    }
+} // namespace
+
+SearchIndex::SearchIndex(const std::filesystem::path& root)
+    : root(root)
+{
+    load();
+}
+
+std::filesystem::path SearchIndex::getPath(const std::filesystem::path& root)
+{
+    auto key = std::filesystem::absolute(root).lexically_normal().string();
+    return getStructuresPath() / "cache" / std::format("{:016x}.index", makeHash64(key));
+}
+
+uint64_t SearchIndex::makeTerm(TermKind kind, uint64_t value)
+{
+    return (static_cast<uint64_t>(kind) << 56) | (value & 0x00FFFFFFFFFFFFFFull);
+}
+
+std::string_view SearchIndex::getKindName(TermKind kind)
+{
+    switch (kind)
+    {
+        case TermKind::HASH: return "hash";
+        case TermKind::INTEGER: return "integer";
+        case TermKind::STRING: return "string";
+    }
+    return "unknown";
+}
+
+void SearchIndex::load()
+{
+    records.clear();
+    file = MappedFile();
+
+    auto path = getPath(root);
+    if (!std::filesystem::is_regular_file(path)) return;
+
+    // the index is only a cache, anything unexpected just means a full rebuild
+    try
+    {
+        file = MappedFile(path);
+        IndexReader reader(file.data());
+
+        if (reader.get<uint32_t>() != INDEX_MAGIC || reader.get<uint32_t>() != INDEX_VERSION)
+            throw std::runtime_error("Outdated index.");
+
+        // path, stamp and the counts of tables and entries
+        records.resize(reader.count(2 * sizeof(uint32_t) + 3 * sizeof(uint64_t)));
+        for (auto& record : records)
+        {
+            record.path       = reader.string();
+            record.stamp.size = reader.get<uint64_t>();
+            record.stamp.time = reader.get<int64_t>();
+
+            record.tables.resize(reader.count(2 * sizeof(uint32_t)));
+            for (auto& table : record.tables)
+            {
+                table.name = reader.string();
+                table.columns.resize(reader.count(sizeof(uint32_t)));
+                for (auto& column : table.columns)
+                    column = reader.string();
+            }
+
+            record.entries = reader.entries();
+        }
+
+        if (!reader.atEnd()) throw std::runtime_error("Trailing data after index.");
+    }
+    catch (std::exception&)
+    {
+        records.clear();
+        file = MappedFile();
+    }
+}
+
+void SearchIndex::save()
+{
+    IndexWriter writer;
+    writer.put(INDEX_MAGIC);
+    writer.put(INDEX_VERSION);
+    writer.put(static_cast<uint32_t>(records.size()));
+
+    for (auto& record : records)
+    {
+        writer.put(std::string_view(record.path));
+        writer.put(record.stamp.size);
+        writer.put(record.stamp.time);
+
+        writer.put(static_cast<uint32_t>(record.tables.size()));
+        for (auto& table : record.tables)
+        {
+            writer.put(std::string_view(table.name));
+            writer.put(static_cast<uint32_t>(table.columns.size()));
+            for (auto& column : table.columns)
+                writer.put(std::string_view(column));
+        }
+
+        writer.put(record.entries);
+    }
+
+    // the entries of unchanged files point into the old index, which has to be unmapped before replacing it
+    records.clear();
+    file = MappedFile();
+
+    auto path = getPath(root);
+    std::filesystem::create_directories(path.parent_path());
+
+    auto tempPath = getTempPath(path);
+    {
+        std::ofstream output(tempPath, std::ios::out | std::ios::binary);
+        output.write(writer.data().data(), writer.data().size());
+        if (!output) throw std::runtime_error("Error: failed to write " + tempPath.string());
+    }
+    std::filesystem::rename(tempPath, path);
+
+    load();
+}
+
+void SearchIndex::scan(FileRecord& record) const
+{
+    PROFILE_SCOPE("index file");
+
+    auto path = root / record.path;
+    MappedFile mapped(path);
+    CSVBView view(mapped.data());
+    if (!view.isValid()) return;
+
+    // column names are only looked up here, queries don't need the structures
+    auto structure = StructureRegistry::find(path, true);
+
+    for (std::size_t i = 0; i < view.tableCount(); i++)
+    {
+        auto source = view.table(i);
+        auto types  = source.types();
+        RowCodec codec(types);
+
+        auto& table = record.tables.emplace_back();
+        table.name  = source.name();
+
+        auto* known = structure ? structure->findTable(table.name) : nullptr;
+        if (known && known->columns.size() == codec.fieldCount())
+            table.columns = known->columns;
+        else
+            for (std::size_t j = 0; j < types.size(); j++)
+                table.columns.push_back(getTypeName(types[j], static_cast<int32_t>(j)));
+
+        for (uint32_t row = 0; row < source.entryCount(); row++)
+        {
+            auto values = source.row(row);
+            for (uint16_t column = 0; column < codec.fieldCount(); column++)
+            {
+                auto& field = codec[column];
+                auto* value = values.data() + field.offset;
+
+                uint64_t term = 0;
+                switch (getTypeTraits(field.type).kind)
+                {
+                    case FieldKind::HASH: term = makeTerm(TermKind::HASH, values.get<uint32_t>(field.offset)); break;
+                    case FieldKind::INTEGER:
+                    {
+                        int32_t number = 0;
+                        if (field.size == 1) number = values.get<int8_t>(field.offset);
+                        if (field.size == 2) number = values.get<int16_t>(field.offset);
+                        if (field.size == 4) number = values.get<int32_t>(field.offset);
+                        // zeros are everywhere and never worth searching for
+                        if (number == 0) continue;
+                        term = makeTerm(TermKind::INTEGER, static_cast<uint32_t>(number));
+                        break;
+                    }
+                    case FieldKind::STRING_REF:
+                    {
+                        auto string = view.string(values.get<uint32_t>(field.offset));
+                        if (string.empty()) continue;
+                        term = makeTerm(TermKind::STRING, makeHash64(string));
+                        break;
+                    }
+                    case FieldKind::INLINE_STRING:
+                    {
+                        auto string = getInlineString(value, field.size);
+                        if (string.empty()) continue;
+                        term = makeTerm(TermKind::STRING, makeHash64(string));
+                        break;
+                    }
+                    default: continue;
+                }
+
+                record.scanned.push_back({ term, row, static_cast<uint16_t>(i), column });
+            }
+        }
+    }
+
+    std::sort(record.scanned.begin(),
+              record.scanned.end(),
+              [](auto& lhs, auto& rhs) { return lhs.term < rhs.term; });
+}
+
+std::size_t SearchIndex::update(ThreadPool& pool)
+{
+    PROFILE_SCOPE("update index");
+
+    std::unordered_map<std::string, FileRecord*> known;
+    for (auto& record : records)
+        known.emplace(record.path, &record);
+
+    std::vector<FileRecord> current;
+    std::vector<std::size_t> changed;
+    for (auto& entry : std::filesystem::recursive_directory_iterator(root))
+    {
+        if (!entry.is_regular_file()) continue;
+
+        auto relative = std::filesystem::relative(entry.path(), root).generic_string();
+        auto stamp    = FileStamp::of(entry.path());
+
+        auto itr = known.find(relative);
+        if (itr != known.end() && itr->second->stamp.sameFile(stamp))
+        {
+            current.push_back(std::move(*itr->second));
+            continue;
+        }
+
+        changed.push_back(current.size());
+        current.push_back({ relative, stamp, {}, {}, {} });
+    }
+
+    // unchanged files keep their entries, removed ones are dropped with the old records
+    bool removed = current.size() - changed.size() != records.size();
+
+    for (auto index : changed)
+        pool.submit(
+            [this, &current, index]
+            {
+                auto& record = current[index];
+                try
+                {
+                    scan(record);
+                }
+                catch (std::exception&)
+                {
+                    // malformed files are indexed without entries, like any other file that isn't a CSVB
+                    record.tables.clear();
+                    record.scanned.clear();
+                }
+                record.entries = record.scanned;
+            });
+    pool.wait();
+
+    std::sort(current.begin(), current.end(), [](auto& lhs, auto& rhs) { return lhs.path < rhs.path; });
+    records = std::move(current);
+    if (!changed.empty() || removed) save();
+
+    return changed.size();
+}
+
+std::vector<SearchIndex::Hit> SearchIndex::find(std::string_view query) const
+{
+    PROFILE_SCOPE("find");
+
+    std::vector<std::pair<uint64_t, TermKind>> terms;
+    terms.emplace_back(makeTerm(TermKind::HASH, makeHash(query)), TermKind::HASH);
+    terms.emplace_back(makeTerm(TermKind::STRING, makeHash64(query)), TermKind::STRING);
+
+    // unresolved hashes are written as 8 hex digits
+    bool prefixed = query.starts_with("0x");
+    auto hex      = prefixed ? query.substr(2) : query;
+    uint32_t hash;
+    auto [hexEnd, hexError] = std::from_chars(hex.data(), hex.data() + hex.size(), hash, 16);
+    if (hexError == std::errc() && hexEnd == hex.data() + hex.size() && (prefixed || hex.size() == 8))
+        terms.emplace_back(makeTerm(TermKind::HASH, hash), TermKind::HASH);
+
+    int64_t number;
+    auto [numberEnd, numberError] = std::from_chars(query.data(), query.data() + query.size(), number);
+    if (numberError == std::errc() && numberEnd == query.data() + query.size() && number != 0
+        && number >= std::numeric_limits<int32_t>::min() && number <= std::numeric_limits<uint32_t>::max())
+        terms.emplace_back(makeTerm(TermKind::INTEGER, static_cast<uint32_t>(number)), TermKind::INTEGER);
+
+    std::vector<Hit> hits;
+    for (auto& record : records)
+    {
+        for (auto [term, kind] : terms)
+        {
+            auto range = std::equal_range(record.entries.begin(),
+                                          record.entries.end(),
+                                          IndexEntry{ term, 0, 0, 0 },
+                                          [](auto& lhs, auto& rhs) { return lhs.term < rhs.term; });
+
+            for (auto itr = range.first; itr != range.second; ++itr)
+            {
+                if (itr->table >= record.tables.size()) continue;
+                auto& table = record.tables[itr->table];
+                if (itr->column >= table.columns.size()) continue;
+
+                hits.push_back({ record.path, table.name, itr->row, table.columns[itr->column], kind });
+            }
+        }
+    }
+
+    std::sort(hits.begin(),
+              hits.end(),
+              [](auto& lhs, auto& rhs)
+              {
+                  return std::tie(lhs.file, lhs.table, lhs.row, lhs.column) <
+                         std::tie(rhs.file, rhs.table, rhs.row, rhs.column);
+              });
+    return hits;
+}
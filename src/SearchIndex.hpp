@@ -0,0 +1,87 @@
+#pragma once
+
+#include "MappedFile.hpp"
+#include "PackManifest.hpp"
+
+#include <cstdint>
+#include <filesystem>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class ThreadPool;
+
+// a value of a field, sorted by term within each file of the index
+struct IndexEntry
+{
+    uint64_t term; // kind in the top byte, see SearchIndex::makeTerm
+    uint32_t row;
+    uint16_t table;
+    uint16_t column;
+};
+
+/*
+ * Inverted index of the hashes, integers and strings of every CSVB file below a folder.
+ * Kept in structures/cache, keyed by the folder. Every file holds its own sorted entries, so files that changed can
+ * be scanned again without touching the others, and a query is a binary search per file in the mapped index.
+ */
+class SearchIndex
+{
+public:
+    enum class TermKind : uint8_t
+    {
+        HASH    = 1,
+        INTEGER = 2,
+        STRING  = 3, // makeHash64 of the text
+    };
+
+    struct Hit
+    {
+        std::filesystem::path file; // relative to the indexed folder
+        std::string table;
+        uint32_t row;
+        std::string column;
+        TermKind kind;
+    };
+
+private:
+    struct TableInfo
+    {
+        std::string name;
+        std::vector<std::string> columns;
+    };
+
+    struct FileRecord
+    {
+        std::string path; // relative, generic format
+        FileStamp stamp;
+        std::vector<TableInfo> tables; // none for files that aren't CSVBs
+        std::vector<IndexEntry> scanned;
+        std::span<const IndexEntry> entries; // into scanned or the mapped index
+    };
+
+    std::filesystem::path root;
+    MappedFile file;
+    std::vector<FileRecord> records; // by path
+
+private:
+    void load();
+    void save();
+    void scan(FileRecord& record) const;
+
+public:
+    // opens the index of root as it was last saved, if there is one
+    explicit SearchIndex(const std::filesystem::path& root);
+
+    // scans the files that are new or changed since the last update and saves the index, returns their number
+    std::size_t update(ThreadPool& pool);
+    // rows with a hash, integer or string field equal to the query, or to the hash given as 8 hex digits
+    std::vector<Hit> find(std::string_view query) const;
+
+    std::size_t fileCount() const { return records.size(); }
+
+    static std::filesystem::path getPath(const std::filesystem::path& root);
+    static uint64_t makeTerm(TermKind kind, uint64_t value);
+    static std::string_view getKindName(TermKind kind);
+};
@@ -0,0 +1,170 @@
+#include "Server.hpp"
+#include "CSVB.hpp"
+#include "PackManifest.hpp"
+#include "Profiler.hpp"
+#include "StructureRegistry.hpp"
+#include "utils.hpp"
+
+#include <format>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+    std::string getString(const boost::json::object& request, std::string_view key)
+    {
+        auto* value = request.if_contains(key);
+        if (!value || !value->is_string()) throw std::invalid_argument(std::format("Missing string \"{}\".", key));
+        return std::string(value->as_string());
+    }
+
+    bool getFlag(const boost::json::object& request, std::string_view key)
+    {
+        auto* value = request.if_contains(key);
+        if (!value) return false;
+        if (!value->is_bool()) throw std::invalid_argument(std::format("\"{}\" must be true or false.", key));
+        return value->as_bool();
+    }
+} // namespace
+
+Server::Server(std::ostream& output, std::size_t jobs)
+    : pool(jobs)
+    , output(output)
+{
+}
+
+void Server::run(std::istream& input)
+{
+    // loaded up front, so the first request doesn't pay for it
+    RainbowTable::getInstance();
+
+    std::string line;
+    while (std::getline(input, line))
+    {
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+        pool.submit([this, line = std::move(line)] { handle(line); });
+    }
+
+    pool.wait();
+}
+
+void Server::handle(const std::string& line)
+{
+    PROFILE_SCOPE("request");
+
+    boost::json::object response;
+    response["id"] = nullptr;
+
+    try
+    {
+        auto parsed = boost::json::parse(line);
+        if (!parsed.is_object()) throw std::invalid_argument("Request must be a JSON object.");
+
+        auto& request = parsed.as_object();
+        if (auto* id = request.if_contains("id")) response["id"] = *id;
+
+        auto command = getString(request, "command");
+        if (command == "extract")
+            response["result"] = extract(request);
+        else if (command == "pack")
+            response["result"] = pack(request);
+        else if (command == "hash")
+            response["result"] = hash(request);
+        else if (command == "reload")
+        {
+            StructureRegistry::clear();
+            response["result"] = boost::json::object();
+        }
+        else
+            throw std::invalid_argument(std::format("Unknown command \"{}\".", command));
+    }
+    catch (std::exception& e)
+    {
+        response["error"] = e.what();
+    }
+
+    respond(response);
+}
+
+void Server::respond(const boost::json::object& response)
+{
+    auto text = boost::json::serialize(response);
+
+    std::lock_guard lock(outputMutex);
+    output << text << '\n';
+    output.flush();
+}
+
+boost::json::object Server::extract(const boost::json::object& request)
+{
+    std::filesystem::path input  = getString(request, "input");
+    std::filesystem::path output = getString(request, "output");
+    bool columnar                = getFlag(request, "columnar");
+
+    // a single file can be extracted by several threads of its own
+    std::size_t jobs = 1;
+    if (auto* value = request.if_contains("jobs"))
+    {
+        if (!value->is_int64() || value->as_int64() < 0)
+            throw std::invalid_argument("\"jobs\" must be a number of threads, 0 for all cores.");
+        jobs = static_cast<std::size_t>(value->as_int64());
+    }
+
+    uint64_t count  = 0;
+    auto exportFile = [&](const std::filesystem::path& path, const std::filesystem::path& target)
+    {
+        CSVBExporter exporter(path);
+        if (!exporter.isValid()) return;
+
+        exporter.setColumnar(columnar);
+        exporter.setJobs(jobs);
+        exporter.write(target, false);
+        count++;
+
+        std::lock_guard lock(rawMutex);
+        exporter.writeStructureJSON(exporter.getRawStructurePath());
+    };
+
+    if (std::filesystem::is_directory(input))
+    {
+        for (auto& path : std::filesystem::recursive_directory_iterator(input))
+            if (path.is_regular_file())
+                exportFile(path.path(), output / std::filesystem::relative(path.path().parent_path(), input));
+    }
+    else if (std::filesystem::is_regular_file(input))
+        exportFile(input, output);
+    else
+        throw std::invalid_argument("Error: input path does not exist.");
+
+    boost::json::object result;
+    result["files"] = count;
+    return result;
+}
+
+boost::json::object Server::pack(const boost::json::object& request)
+{
+    std::filesystem::path input  = getString(request, "input");
+    std::filesystem::path output = getString(request, "output");
+    bool mergeStrings            = getFlag(request, "mergeStrings");
+
+    boost::json::object result;
+    if (getFlag(request, "incremental"))
+        result["packed"] = packIncremental(input, output, mergeStrings);
+    else
+    {
+        CSVBImporter importer(input, mergeStrings);
+        importer.write(output);
+        result["packed"] = true;
+    }
+    return result;
+}
+
+boost::json::object Server::hash(const boost::json::object& request)
+{
+    auto hash = makeHash(getString(request, "string"));
+
+    boost::json::object result;
+    result["hash"] = hash;
+    result["hex"]  = std::format("{:08x}", hash);
+    return result;
+}
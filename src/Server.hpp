@@ -0,0 +1,41 @@
+#pragma once
+
+#include "ThreadPool.hpp"
+
+#include <boost/json.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <mutex>
+#include <ostream>
+#include <string>
+
+/*
+ * Request loop of --serve.
+ * Every input line is a JSON object with a "command" and an optional "id", answered by one JSON line with the same
+ * "id" and either "result" or "error". Requests run concurrently on a ThreadPool, so responses come in the order they
+ * finish. Structures and the rainbow table stay loaded between requests, which is the point of serving.
+ */
+class Server
+{
+    ThreadPool pool;
+    std::ostream& output;
+    std::mutex outputMutex;
+    std::mutex rawMutex; // raw structures written by concurrent extractions
+
+private:
+    void handle(const std::string& line);
+    void respond(const boost::json::object& response);
+
+    boost::json::object extract(const boost::json::object& request);
+    boost::json::object pack(const boost::json::object& request);
+    boost::json::object hash(const boost::json::object& request);
+
+public:
+    // 0 jobs uses all cores
+    Server(std::ostream& output, std::size_t jobs);
+
+    // answers requests until the end of input, returns once every request was answered
+    void run(std::istream& input);
+};
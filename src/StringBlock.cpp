@@ -0,0 +1,137 @@
+#include "CSVB.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <numeric>
+
+namespace
+{
+    constexpr std::size_t INITIAL_SLOTS = 1024;
+
+    std::size_t alignedSize(std::size_t length) { return (length + 4) & ~3; }
+} // namespace
+
+StringBlock::StringBlock(bool mergeSuffixes)
+    : slots(INITIAL_SLOTS)
+    , mergeSuffixes(mergeSuffixes)
+{
+}
+
+void StringBlock::grow()
+{
+    std::vector<Slot> newSlots(slots.size() * 2);
+    const auto mask = newSlots.size() - 1;
+
+    for (auto& slot : slots)
+    {
+        if (slot.index == 0) continue;
+
+        auto pos = slot.hash & mask;
+        while (newSlots[pos].index != 0)
+            pos = (pos + 1) & mask;
+        newSlots[pos] = slot;
+    }
+
+    slots = std::move(newSlots);
+}
+
+uint32_t StringBlock::add(std::string_view string)
+{
+    // keep the load factor below 1/2
+    if ((entries.size() + 1) * 2 > slots.size()) grow();
+
+    const auto hash = static_cast<uint32_t>(std::hash<std::string_view>{}(string));
+    const auto mask = slots.size() - 1;
+
+    auto pos = hash & mask;
+    for (; slots[pos].index != 0; pos = (pos + 1) & mask)
+    {
+        auto& entry = entries[slots[pos].index - 1];
+        if (slots[pos].hash == hash && get(entry) == string) return entry.offset;
+    }
+
+    Entry entry{ static_cast<uint32_t>(arena.size()), static_cast<uint32_t>(string.size()) };
+    arena.insert(arena.end(), string.begin(), string.end());
+    arena.resize(entry.offset + alignedSize(string.size()));
+
+    entries.push_back(entry);
+    slots[pos] = { hash, static_cast<uint32_t>(entries.size()) };
+
+    return entry.offset;
+}
+
+void StringBlock::layout()
+{
+    if (!mergeSuffixes) return;
+
+    // sorted by their reversed text, a string is followed by the strings it is a suffix of
+    std::vector<uint32_t> order(entries.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(),
+              order.end(),
+              [this](uint32_t lhs, uint32_t rhs)
+              {
+                  auto l = get(entries[lhs]);
+                  auto r = get(entries[rhs]);
+                  return std::lexicographical_compare(l.rbegin(), l.rend(), r.rbegin(), r.rend());
+              });
+
+    std::vector<uint32_t> owner(entries.size());
+    for (auto k = entries.size(); k-- > 0;)
+    {
+        auto index   = order[k];
+        auto text    = get(entries[index]);
+        owner[index] = index;
+
+        // the empty string keeps a place of its own
+        if (text.empty() || k + 1 == entries.size()) continue;
+
+        auto next = order[k + 1];
+        if (get(entries[next]).ends_with(text)) owner[index] = owner[next];
+    }
+
+    merged.clear();
+    mergedOffsets.assign(entries.size(), 0);
+    for (uint32_t i = 0; i < entries.size(); i++)
+    {
+        if (owner[i] != i) continue;
+
+        auto text        = get(entries[i]);
+        mergedOffsets[i] = static_cast<uint32_t>(merged.size());
+        merged.insert(merged.end(), text.begin(), text.end());
+        merged.resize(mergedOffsets[i] + alignedSize(text.size()));
+    }
+
+    for (uint32_t i = 0; i < entries.size(); i++)
+        if (owner[i] != i)
+            mergedOffsets[i] = mergedOffsets[owner[i]] + entries[owner[i]].length - entries[i].length;
+}
+
+std::size_t StringBlock::find(uint32_t offset) const
+{
+    auto byOffset = [](const Entry& entry, uint32_t value) { return entry.offset < value; };
+    auto itr      = std::lower_bound(entries.begin(), entries.end(), offset, byOffset);
+    if (itr == entries.end() || itr->offset != offset) throw std::out_of_range("Unknown string offset.");
+
+    return itr - entries.begin();
+}
+
+uint32_t StringBlock::resolve(uint32_t offset) const
+{
+    if (!mergeSuffixes) return offset;
+    return mergedOffsets[find(offset)];
+}
+
+std::size_t StringBlock::totalSize() const
+{
+    // the section always ends in 1 to 16 bytes of padding
+    auto size = mergeSuffixes ? merged.size() : arena.size();
+    return size + 0x10 - size % 0x10;
+}
+
+void StringBlock::copyTo(char* dest) const
+{
+    auto& source = mergeSuffixes ? merged : arena;
+    std::copy(source.begin(), source.end(), dest);
+    std::fill(dest + source.size(), dest + totalSize(), 0);
+}
@@ -0,0 +1,154 @@
+#include "StructureRegistry.hpp"
+#include "Profiler.hpp"
+#include "utils.hpp"
+
+#include <format>
+#include <mutex>
+
+namespace
+{
+    std::shared_ptr<const Structure> readStructure(const std::filesystem::path& path)
+    {
+        PROFILE_SCOPE("parse structure");
+
+        try
+        {
+            auto contents         = getFileAsString(path);
+            auto structure        = StructureRegistry::parse(boost::json::parse(contents).as_object());
+            structure.fingerprint = makeHash64(contents);
+            return std::make_shared<const Structure>(std::move(structure));
+        }
+        catch (std::exception& e)
+        {
+            throw std::runtime_error(std::format("{}: invalid structure: {}", path.string(), e.what()));
+        }
+    }
+} // namespace
+
+const TableStructure* Structure::findTable(std::string_view name) const
+{
+    for (auto& table : tables)
+        if (table.name == name) return &table;
+    return nullptr;
+}
+
+StructureRegistry& StructureRegistry::getInstance()
+{
+    static StructureRegistry instance;
+    return instance;
+}
+
+StructureRegistry::StructureRegistry()
+{
+    auto mappingPath = getStructuresPath() / "structures.json";
+    if (!std::filesystem::is_regular_file(mappingPath)) return;
+
+    auto mapping = boost::json::parse(getFileAsString(mappingPath)).as_object();
+    for (auto& var : mapping)
+    {
+        std::filesystem::path file = getStructuresPath() / std::string(var.value().as_string());
+        patterns.push_back({ std::regex(var.key_c_str(), std::regex::optimize), file });
+    }
+}
+
+Structure StructureRegistry::parse(boost::json::object json)
+{
+    Structure structure;
+
+    for (auto& table : json)
+    {
+        auto& obj = table.value().as_object();
+
+        TableStructure entry;
+        entry.name = std::string(table.key());
+        entry.flag = obj.at("flag").to_number<uint32_t>(); // uint64 in structures built by the exporter
+
+        for (auto& column : obj.at("structure").as_array())
+        {
+            auto& columnObj = column.as_object();
+            entry.columns.push_back(std::string(columnObj.at("name").as_string()));
+            entry.types.push_back(convertToType(std::string(columnObj.at("type").as_string())));
+        }
+
+        entry.codec = RowCodec(entry.types);
+        structure.tables.push_back(std::move(entry));
+    }
+
+    structure.json = std::move(json);
+    return structure;
+}
+
+std::shared_ptr<const Structure> StructureRegistry::loadFile(const std::filesystem::path& path)
+{
+    auto key = path.string();
+    {
+        std::shared_lock lock(mutex);
+        if (auto it = files.find(key); it != files.end()) return it->second;
+    }
+
+    auto structure = readStructure(path);
+
+    std::unique_lock lock(mutex);
+    return files.emplace(key, std::move(structure)).first->second;
+}
+
+std::shared_ptr<const Structure> StructureRegistry::findMapped(const std::filesystem::path& source)
+{
+    auto key = source.string();
+    {
+        std::shared_lock lock(mutex);
+        if (auto it = sources.find(key); it != sources.end()) return it->second;
+    }
+
+    std::shared_ptr<const Structure> structure;
+    for (auto& pattern : patterns)
+    {
+        if (std::regex_search(key, pattern.regex))
+        {
+            structure = loadFile(pattern.file);
+            break;
+        }
+    }
+
+    std::unique_lock lock(mutex);
+    return sources.emplace(key, std::move(structure)).first->second;
+}
+
+std::shared_ptr<const Structure> StructureRegistry::findRaw(const std::filesystem::path& source)
+{
+    auto folderName               = source.has_filename() ? source.filename() : source.parent_path().filename();
+    std::filesystem::path rawPath = (getRawStructuresPath() / folderName).concat(".json");
+    if (!std::filesystem::is_regular_file(rawPath)) return nullptr;
+
+    auto key  = rawPath.string();
+    auto time = std::filesystem::last_write_time(rawPath);
+    auto size = std::filesystem::file_size(rawPath);
+    {
+        std::shared_lock lock(mutex);
+        auto it = raw.find(key);
+        if (it != raw.end() && it->second.time == time && it->second.size == size) return it->second.structure;
+    }
+
+    auto structure = readStructure(rawPath);
+
+    std::unique_lock lock(mutex);
+    raw[key] = { time, size, structure };
+    return structure;
+}
+
+std::shared_ptr<const Structure> StructureRegistry::_find(const std::filesystem::path& source, bool useRaw)
+{
+    PROFILE_SCOPE("find structure");
+
+    if (auto structure = findMapped(source)) return structure;
+    if (useRaw) return findRaw(source);
+    return nullptr;
+}
+
+void StructureRegistry::_clear()
+{
+    std::unique_lock lock(mutex);
+    files.clear();
+    sources.clear();
+    raw.clear();
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "CSVB.hpp"
+
+#include <boost/json.hpp>
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <regex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct TableStructure
+{
+    std::string name;
+    uint32_t flag;
+    std::vector<std::string> columns;
+    std::vector<DataType> types;
+    RowCodec codec;
+};
+
+// a parsed structure file, shared by every CSVB it applies to
+struct Structure
+{
+    boost::json::object json;
+    std::vector<TableStructure> tables; // in file order
+    uint64_t fingerprint = 0;           // hash of the structure file
+
+    const TableStructure* findTable(std::string_view name) const;
+};
+
+/*
+ * Process wide cache of the structure definitions.
+ * structures.json is read and its patterns compiled on first use. Every structure file is parsed once, together with
+ * the layout of its tables, and the structure found for a source path is remembered, so the hundreds of map_NNNN
+ * files of a batch all share one map.json. Raw structures are written by exports and re-read once they change.
+ */
+class StructureRegistry
+{
+    struct Pattern
+    {
+        std::regex regex;
+        std::filesystem::path file;
+    };
+
+    struct RawEntry
+    {
+        std::filesystem::file_time_type time;
+        uintmax_t size;
+        std::shared_ptr<const Structure> structure;
+    };
+
+    std::vector<Pattern> patterns; // in order of structures.json, the first match wins
+
+    std::shared_mutex mutex;
+    std::unordered_map<std::string, std::shared_ptr<const Structure>> files;   // by structure file
+    std::unordered_map<std::string, std::shared_ptr<const Structure>> sources; // by source path, null if unmapped
+    std::unordered_map<std::string, RawEntry> raw;                             // by raw structure file
+
+private:
+    StructureRegistry();
+    StructureRegistry(StructureRegistry& copy) = delete;
+
+    std::shared_ptr<const Structure> loadFile(const std::filesystem::path& path);
+    std::shared_ptr<const Structure> findMapped(const std::filesystem::path& source);
+    std::shared_ptr<const Structure> findRaw(const std::filesystem::path& source);
+
+public:
+    std::shared_ptr<const Structure> _find(const std::filesystem::path& source, bool useRaw);
+    void _clear();
+
+public:
+    static StructureRegistry& getInstance();
+    static Structure parse(boost::json::object json);
+    // the structure for a CSVB file or an extracted folder, raw structures are only considered if useRaw is set
+    static std::shared_ptr<const Structure> find(const std::filesystem::path& source, bool useRaw = false)
+    {
+        return getInstance()._find(source, useRaw);
+    }
+    // forgets all parsed structures, the patterns of structures.json are kept
+    static void clear() { getInstance()._clear(); }
+};
@@ -0,0 +1,136 @@
+#include "ThreadPool.hpp"
+
+namespace
+{
+    struct WorkerContext
+    {
+        const ThreadPool* pool = nullptr;
+        std::size_t index      = 0;
+    };
+
+    thread_local WorkerContext currentWorker;
+} // namespace
+
+std::size_t ThreadPool::defaultThreadCount()
+{
+    auto count = std::thread::hardware_concurrency();
+    return count == 0 ? 1 : count;
+}
+
+ThreadPool::ThreadPool(std::size_t threadCount)
+{
+    if (threadCount == 0) threadCount = defaultThreadCount();
+
+    for (std::size_t i = 0; i < threadCount; i++)
+        queues.push_back(std::make_unique<Queue>());
+    for (std::size_t i = 0; i < threadCount; i++)
+        threads.emplace_back([this, i] { run(i); });
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard lock(stateMutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+
+    for (auto& thread : threads)
+        thread.join();
+}
+
+void ThreadPool::submit(Task task)
+{
+    std::size_t index;
+    if (currentWorker.pool == this)
+        index = currentWorker.index;
+    else
+        index = nextQueue.fetch_add(1, std::memory_order_relaxed) % queues.size();
+
+    {
+        std::lock_guard lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard lock(stateMutex);
+        queued++;
+        pending++;
+    }
+    workAvailable.notify_one();
+}
+
+void ThreadPool::wait()
+{
+    std::unique_lock lock(stateMutex);
+    allDone.wait(lock, [this] { return pending == 0; });
+
+    if (firstError)
+    {
+        auto error = firstError;
+        firstError = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+bool ThreadPool::take(std::size_t index, Task& task)
+{
+    {
+        auto& own = *queues[index];
+        std::lock_guard lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+
+    for (std::size_t i = 1; i < queues.size(); i++)
+    {
+        auto& victim = *queues[(index + i) % queues.size()];
+        std::lock_guard lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ThreadPool::run(std::size_t index)
+{
+    currentWorker = { this, index };
+
+    while (true)
+    {
+        {
+            std::unique_lock lock(stateMutex);
+            workAvailable.wait(lock, [this] { return queued > 0 || stopping; });
+            if (queued == 0 && stopping) return;
+        }
+
+        Task task;
+        if (!take(index, task)) continue;
+
+        {
+            std::lock_guard lock(stateMutex);
+            queued--;
+        }
+
+        try
+        {
+            task();
+        }
+        catch (...)
+        {
+            std::lock_guard lock(stateMutex);
+            if (!firstError) firstError = std::current_exception();
+        }
+
+        std::lock_guard lock(stateMutex);
+        if (--pending == 0) allDone.notify_all();
+    }
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+ * Work-stealing thread pool.
+ * Every worker owns a deque. Tasks submitted from inside a worker go to its own deque, everything else is
+ * distributed round-robin. Idle workers take from the back of their own deque first and steal from the front of
+ * the others afterwards.
+ */
+class ThreadPool
+{
+public:
+    using Task = std::function<void()>;
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> threads;
+
+    std::mutex stateMutex;
+    std::condition_variable workAvailable;
+    std::condition_variable allDone;
+    std::size_t queued  = 0; // tasks waiting in any queue
+    std::size_t pending = 0; // tasks queued or running
+    bool stopping       = false;
+    std::exception_ptr firstError;
+
+    std::atomic<std::size_t> nextQueue = 0;
+
+private:
+    void run(std::size_t index);
+    bool take(std::size_t index, Task& task);
+
+public:
+    // 0 uses one thread per hardware thread
+    explicit ThreadPool(std::size_t threadCount = 0);
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&)            = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(Task task);
+    // Blocks until every submitted task has finished and rethrows the first exception thrown by a task.
+    // Must not be called from inside a task.
+    void wait();
+    std::size_t size() const { return threads.size(); }
+
+    static std::size_t defaultThreadCount();
+};
@@ -1,9 +1,18 @@
 #include "utils.hpp"
+#include "StructureRegistry.hpp"
 
+#include <format>
 #include <fstream>
-#include <regex>
+#include <functional>
+#include <sstream>
+#include <thread>
 
-RainbowTable RainbowTable::instance;
+#ifdef _WIN32
+#    include <process.h>
+#    define getpid _getpid
+#else
+#    include <unistd.h>
+#endif
 
 // taken from Boost.JSON documentation
 // https://www.boost.org/doc/libs/1_80_0/libs/json/doc/html/json/examples.html#json.examples.pretty
@@ -98,42 +107,39 @@ std::string getFileAsString(std::filesystem::path path)
 
 boost::json::object getStructureFile(std::filesystem::path source, bool useRaw)
 {
-    auto structJson               = getFileAsString(getStructuresPath() / "structures.json");
-    boost::json::object structure = boost::json::parse(structJson).as_object();
-
-    for (auto& var : structure)
-    {
-        if (std::regex_search(source.string(), std::regex{ var.key_c_str() }))
-        {
-            std::filesystem::path formatPath = getStructuresPath() / std::string(var.value().as_string());
-            return boost::json::parse(getFileAsString(formatPath)).as_object();
-        }
-    }
-
-    if (useRaw)
-    {
-        auto folderName               = source.has_filename() ? source.filename() : source.parent_path().filename();
-        std::filesystem::path rawPath = (getRawStructuresPath() / folderName).concat(".json");
-        if (std::filesystem::is_regular_file(rawPath)) return boost::json::parse(getFileAsString(rawPath)).as_object();
-    }
-
-    return {};
+    auto structure = StructureRegistry::find(source, useRaw);
+    return structure ? structure->json : boost::json::object();
 }
 
 std::filesystem::path getStructuresPath() { return "structures"; }
 std::filesystem::path getRawStructuresPath() { return getStructuresPath() / "raw"; }
 
 
-uint32_t makeHash(const std::string& input)
+uint32_t makeHash(std::string_view input)
 {
     if (input.empty()) return 0xFFFFFFFF;
 
     uint32_t num = 2166136261u;
+    for (auto c : input)
+        num = hashStep(num, c);
+
+    return num;
+}
+
+uint64_t makeHash64(std::string_view input)
+{
+    uint64_t hash = 14695981039346656037ull;
     for (auto c : input)
     {
-        num *= 16777619;
-        num ^= c;
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 1099511628211ull;
     }
+    return hash;
+}
 
-    return num;
-}
\ No newline at end of file
+std::filesystem::path getTempPath(const std::filesystem::path& path)
+{
+    // the thread id alone can repeat between processes writing the same file
+    auto threadId = std::hash<std::thread::id>{}(std::this_thread::get_id());
+    return std::filesystem::path(path).concat(std::format(".{}.{:x}.tmp", getpid(), threadId));
+}